@@ -0,0 +1,573 @@
+// Benchmarks for tetris-engine.
+//
+// Prints one tab-separated line per measurement:
+//    benchmark  board  iterations  ns_per_op  ops_per_second  note
+// so results can be diffed or loaded into a spreadsheet to catch regressions.
+// A note of "unreliable" marks an op too cheap next to its setup to be told
+// apart from timer noise; its numbers ("-" if negative) should not be
+// compared. A note of "skipped" marks a board whose seeded position could
+// not be prepared; none of its operations are measured.
+//
+// Board states are produced by playing seeded games, so every run measures
+// the same positions.
+//
+// Built with -DTETRIS_ENGINE_FIXED_WIDTH=W -DTETRIS_ENGINE_FIXED_HEIGHT=H the
+// benchmark uses the header-only engine_fixed.h instead of engine.c, measures
+// only the WxH board and labels it "WxH-fixed".
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef TETRIS_ENGINE_FIXED_WIDTH
+#include <engine_fixed.h>
+#define benchBoardSuffix "-fixed"
+#else
+#include <engine.h>
+#define benchBoardSuffix ""
+
+// internal hot spots of engine.c (not declared in engine.h)
+int8_t cleanLines(Game* game);
+void lockActiveTetromino(Game* game);
+unsigned canActiveTetrominoMoveDown(Game* game);
+unsigned canActiveTetrominoRotateClockwise(Game* game);
+unsigned canActiveTetrominoRotateAgainstClockwise(Game* game);
+#endif
+
+#define benchMinimumNs 50000000.0 // each benchmark runs for at least 50 ms
+#define benchSetupRounds 5        // interleaved rounds for benchmarks with a setup
+#define benchNoiseShare 0.05      // ops cheaper than this share of their setup are unreliable
+#define benchSeed 20240601u
+#define placementCapacity 4096
+
+typedef struct tagBenchBoard {
+   GameCoordinate width;
+   GameCoordinate height;
+} BenchBoard;
+
+static const BenchBoard benchBoards[] = {
+#ifdef TETRIS_ENGINE_FIXED_WIDTH
+   {TETRIS_ENGINE_FIXED_WIDTH, TETRIS_ENGINE_FIXED_HEIGHT},
+#else
+   {10, 20},
+   {24, 48},
+   {100, 100},
+#endif
+};
+
+// State shared by one group of benchmarks
+typedef struct tagBenchContext {
+   Game* game;
+   void* spawned;     // snapshot: new piece just spawned over a half-filled board
+   void* hovering;    // snapshot: the same piece a few rows above the stack
+   void* landing;     // snapshot: the next tick locks the piece and clears lines
+   Placement clearing; // placement of the piece in `landing` that clears lines
+   Placement* placements;
+   void* placementScratch; // scratch for findPlacementsWithScratch
+   int placementCount; // placements of the piece in `spawned`
+   GameCoordinate fallRows; // rows between `spawned` and `hovering`
+   Game* scratch;
+   uint8_t* packed;   // packed state of `hovering` with colours
+   size_t packedSize;
+   volatile unsigned sink;
+} BenchContext;
+
+typedef void BenchFunction(BenchContext* context);
+
+static uint32_t getScoreAddend(int8_t cleanedLines) {
+   return (uint32_t) cleanedLines;
+}
+
+static double nowNs(void) {
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static uint64_t benchRandomState = benchSeed;
+
+static unsigned benchRandom(void) {
+   benchRandomState = benchRandomState * 6364136223846793005ull + 1442695040888963407ull;
+   return (unsigned) (benchRandomState >> 33);
+}
+
+static double timeLoop(BenchContext* context, BenchFunction* setup, BenchFunction* op, unsigned long iterations) {
+   double start = nowNs();
+   for (unsigned long i = 0; i < iterations; ++i) {
+      if (setup) {
+         setup(context);
+      }
+      if (op) {
+         op(context);
+      }
+   }
+   return nowNs() - start;
+}
+
+// Times `op`, which performs `opsPerCall` operations per call. If `setup` is
+// given it runs before every op and its own time is subtracted: setup-only
+// and setup+op loops are interleaved for several rounds and the fastest of
+// each is kept, so one slow round does not skew the difference.
+static void runBenchmark(const char* name, const BenchBoard* board, BenchContext* context,
+      BenchFunction* setup, BenchFunction* op, unsigned long opsPerCall) {
+   unsigned long iterations = 256;
+   double elapsed;
+   for (;;) {
+      elapsed = timeLoop(context, setup, op, iterations);
+      if (elapsed >= benchMinimumNs) {
+         break;
+      }
+      iterations *= 2;
+   }
+   int isReliable = 1;
+   if (setup) {
+      double setupElapsed = timeLoop(context, setup, NULL, iterations);
+      for (int round = 1; round < benchSetupRounds; ++round) {
+         double roundElapsed = timeLoop(context, setup, op, iterations);
+         double roundSetupElapsed = timeLoop(context, setup, NULL, iterations);
+         if (roundElapsed < elapsed) {
+            elapsed = roundElapsed;
+         }
+         if (roundSetupElapsed < setupElapsed) {
+            setupElapsed = roundSetupElapsed;
+         }
+      }
+      elapsed -= setupElapsed;
+      isReliable = elapsed >= setupElapsed * benchNoiseShare;
+   }
+   double nsPerOp = elapsed / iterations / (opsPerCall ? opsPerCall : 1);
+   if (nsPerOp > 0) {
+      printf("%s\t%dx%d" benchBoardSuffix "\t%lu\t%.2f\t%.0f\t%s\n", name, board->width, board->height, iterations,
+            nsPerOp, 1e9 / nsPerOp, isReliable ? "" : "unreliable");
+   } else {
+      printf("%s\t%dx%d" benchBoardSuffix "\t%lu\t-\t-\tunreliable\n", name, board->width, board->height, iterations);
+   }
+}
+
+// Picks the lowest reachable placement, breaking ties at random
+static int chooseLowestPlacement(Game* game, Placement* placements) {
+   int count = findPlacements(game, placements, placementCapacity);
+   if (count <= 0) {
+      return -1;
+   }
+   if (count > placementCapacity) {
+      count = placementCapacity;
+   }
+   int best = 0;
+   for (int i = 1; i < count; ++i) {
+      if (placements[i].y < placements[best].y || (placements[i].y == placements[best].y && benchRandom() % 4 == 0)) {
+         best = i;
+      }
+   }
+   return best;
+}
+
+static int getStackHeight(const Game* game) {
+   int height = 0;
+   for (int x = 0; x < game->width; ++x) {
+      if (game->columnHeights[x] > height) {
+         height = game->columnHeights[x];
+      }
+   }
+   return height;
+}
+
+// Finds a placement of the active piece that clears at least one line
+static int findClearingPlacement(Game* game, Game* scratch, Placement* placements, Placement* clearing) {
+   int count = findPlacements(game, placements, placementCapacity);
+   if (count > placementCapacity) {
+      count = placementCapacity;
+   }
+   for (int i = 0; i < count; ++i) {
+      cloneGame(scratch, game);
+      uint32_t score = scratch->score;
+      placeActiveTetromino(scratch, placements + i);
+      if (scratch->score > score) {
+         *clearing = placements[i];
+         return 1;
+      }
+   }
+   return 0;
+}
+
+// Plays a seeded game until the stack is half the board high and records the
+// snapshots used by the benchmarks. The first position that allows a line
+// clear on the way is kept for the landing benchmarks. The random state is
+// reset so the position does not depend on how many draws earlier
+// benchmarks made.
+static int prepareContext(BenchContext* context, const BenchBoard* board) {
+   benchRandomState = benchSeed;
+   Game* game = initGame(board->width, board->height, UINT32_MAX, NULL, getScoreAddend);
+   Game* scratch = initGame(board->width, board->height, UINT32_MAX, NULL, getScoreAddend);
+   size_t snapshotSize = gameSnapshotSize(game);
+   int hasLanding = 0;
+   context->game = game;
+   context->spawned = malloc(snapshotSize);
+   context->hovering = malloc(snapshotSize);
+   context->landing = malloc(snapshotSize);
+   context->placements = (Placement*) malloc(placementCapacity * sizeof(Placement));
+   context->placementScratch = malloc(placementScratchBytes(board->width, board->height));
+   setTetrominoGenerator(game, bagTetrominoGenerator, benchSeed);
+   startGame(game);
+   for (;;) {
+      if (game->status != playGameStatus) {
+         freeGame(scratch);
+         return 0;
+      }
+      if (!hasLanding && findClearingPlacement(game, scratch, context->placements, &context->clearing)) {
+         cloneGame(scratch, game);
+         ActiveTetromino* activeTetromino = scratch->activeTetromino;
+         activeTetromino->x = context->clearing.x;
+         activeTetromino->y = context->clearing.y;
+         activeTetromino->orientation = context->clearing.orientation;
+         activeTetromino->pixels = activeTetromino->orientationPixels + context->clearing.orientation * tetrominoArrayMaxSize;
+         snapshotGame(scratch, context->landing);
+         hasLanding = 1;
+      }
+      if (hasLanding && getStackHeight(game) >= board->height / 2) {
+         break;
+      }
+      int best = chooseLowestPlacement(game, context->placements);
+      if (best < 0) {
+         freeGame(scratch);
+         return 0;
+      }
+      placeActiveTetromino(game, context->placements + best);
+   }
+   snapshotGame(game, context->spawned);
+   context->placementCount = findPlacements(game, context->placements, placementCapacity);
+   if (context->placementCount > placementCapacity) {
+      context->placementCount = placementCapacity;
+   }
+   GameCoordinate dropped;
+   softDrop(game, (GameCoordinate) (board->height - getStackHeight(game)), &dropped);
+   context->fallRows = dropped;
+   snapshotGame(game, context->hovering);
+   context->packed = malloc(packedGameStateMaxSize(board->width, board->height, colorsPackedGameStateFlag));
+   context->packedSize = packGameState(game, colorsPackedGameStateFlag, context->packed,
+         packedGameStateMaxSize(board->width, board->height, colorsPackedGameStateFlag));
+   context->scratch = scratch;
+   return 1;
+}
+
+static void freeContext(BenchContext* context) {
+   freeGame(context->game);
+   freeGame(context->scratch);
+   free(context->spawned);
+   free(context->hovering);
+   free(context->landing);
+   free(context->packed);
+   free(context->placements);
+   free(context->placementScratch);
+}
+
+static void restoreSpawned(BenchContext* context) {
+   restoreGame(context->game, context->spawned);
+}
+
+static void restoreHovering(BenchContext* context) {
+   restoreGame(context->game, context->hovering);
+}
+
+static void restoreLanding(BenchContext* context) {
+   restoreGame(context->game, context->landing);
+}
+
+static void restoreLandingAndLock(BenchContext* context) {
+   restoreGame(context->game, context->landing);
+   lockActiveTetromino(context->game);
+}
+
+static void benchTick(BenchContext* context) {
+   context->sink += tick(context->game);
+}
+
+// One fall of the spawned piece through the empty rows above the stack
+static void benchFall(BenchContext* context) {
+   unsigned sum = 0;
+   for (GameCoordinate i = 0; i < context->fallRows; ++i) {
+      sum += tick(context->game);
+   }
+   context->sink += sum;
+}
+
+static void benchHardDrop(BenchContext* context) {
+   context->sink += hardDrop(context->game, NULL);
+}
+
+static void benchMoveLeftRight(BenchContext* context) {
+   context->sink += moveLeft(context->game);
+   context->sink += moveRight(context->game);
+}
+
+static void benchRotateClockwise(BenchContext* context) {
+   context->sink += rotateClockwise(context->game);
+}
+
+static void benchRotateAgainstClockwise(BenchContext* context) {
+   context->sink += rotateAgainstClockwise(context->game);
+}
+
+static void benchCanRotateClockwise(BenchContext* context) {
+   context->sink += canActiveTetrominoRotateClockwise(context->game);
+}
+
+static void benchCanRotateAgainstClockwise(BenchContext* context) {
+   context->sink += canActiveTetrominoRotateAgainstClockwise(context->game);
+}
+
+static void benchCanMoveDown(BenchContext* context) {
+   context->sink += canActiveTetrominoMoveDown(context->game);
+}
+
+static void benchGetGameFieldPixel(BenchContext* context) {
+   Game* game = context->game;
+   unsigned sum = 0;
+   for (GameCoordinate y = 0; y < game->height; ++y) {
+      for (GameCoordinate x = 0; x < game->width; ++x) {
+         sum += getGameFieldPixel(game, x, y);
+      }
+   }
+   context->sink += sum;
+}
+
+static void benchLockActiveTetromino(BenchContext* context) {
+   lockActiveTetromino(context->game);
+}
+
+static void benchCleanLines(BenchContext* context) {
+   context->sink += cleanLines(context->game);
+}
+
+static void benchFindPlacements(BenchContext* context) {
+   context->sink += findPlacements(context->game, context->placements, placementCapacity);
+}
+
+static void benchFindPlacementsWithScratch(BenchContext* context) {
+   context->sink += findPlacementsWithScratch(context->game, context->placementScratch, context->placements,
+         placementCapacity);
+}
+
+// Evaluates every placement of the spawned piece with the incrementally
+// maintained board features
+static void benchEvaluatePlacements(BenchContext* context) {
+   BoardFeatures features;
+   unsigned sum = 0;
+   for (int i = 0; i < context->placementCount; ++i) {
+      if (evaluatePlacement(context->game, context->placements + i, &features) >= 0) {
+         sum += features.holes + features.bumpiness;
+      }
+   }
+   context->sink += sum;
+}
+
+// The same evaluation done by placing every piece on a copy and scanning the
+// whole field with getGameFieldPixel
+static void benchScanPlacements(BenchContext* context) {
+   Game* scratch = context->scratch;
+   unsigned sum = 0;
+   for (int i = 0; i < context->placementCount; ++i) {
+      cloneGame(scratch, context->game);
+      placeActiveTetromino(scratch, context->placements + i);
+      setGameFieldMode(scratch, lockedGameFieldMode);
+      int previousHeight = -1;
+      for (GameCoordinate x = 0; x < scratch->width; ++x) {
+         int height = 0;
+         for (GameCoordinate y = 0; y < scratch->height; ++y) {
+            if (getGameFieldPixel(scratch, x, y)) {
+               height = y + 1;
+            }
+         }
+         for (GameCoordinate y = 0; y < height; ++y) {
+            sum += !getGameFieldPixel(scratch, x, y);
+         }
+         if (previousHeight >= 0) {
+            sum += abs(height - previousHeight);
+         }
+         previousHeight = height;
+      }
+      setGameFieldMode(scratch, compositeGameFieldMode);
+   }
+   context->sink += sum;
+}
+
+static void benchRestoreGame(BenchContext* context) {
+   restoreGame(context->game, context->hovering);
+}
+
+static void benchGetGameHash(BenchContext* context) {
+   context->sink += (unsigned) getGameHash(context->game);
+}
+
+// The same position hashed from scratch: the whole field and the active piece
+static void benchHashGameField(BenchContext* context) {
+   const Game* game = context->game;
+   const ActiveTetromino* activeTetromino = game->activeTetromino;
+   uint64_t hash = 0xCBF29CE484222325ull;
+   for (int i = 0; i < game->width * game->height; ++i) {
+      hash = (hash ^ game->gameField[i]) * 0x100000001B3ull;
+   }
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      hash = (hash ^ activeTetromino->pixels[i]) * 0x100000001B3ull;
+   }
+   hash = (hash ^ (uint16_t) activeTetromino->x ^ (uint32_t) (uint16_t) activeTetromino->y << 16) * 0x100000001B3ull;
+   context->sink += (unsigned) hash;
+}
+
+static void benchPackGameState(BenchContext* context) {
+   context->sink += (unsigned) packGameState(context->game, 0, context->packed, context->packedSize);
+}
+
+static void benchPackGameStateColors(BenchContext* context) {
+   context->sink += (unsigned) packGameState(context->game, colorsPackedGameStateFlag, context->packed,
+         context->packedSize);
+}
+
+static void benchUnpackGameState(BenchContext* context) {
+   context->sink += unpackGameState(context->scratch, context->packed, context->packedSize);
+}
+
+static void benchOperations(const BenchBoard* board) {
+   BenchContext context;
+   memset(&context, 0, sizeof(context));
+   if (!prepareContext(&context, board)) {
+      printf("operations\t%dx%d" benchBoardSuffix "\t-\t-\t-\tskipped\n", board->width, board->height);
+      freeContext(&context);
+      return;
+   }
+   // one restore per fall of the spawned piece, divided by the rows it falls
+   runBenchmark("tick_falling", board, &context, restoreSpawned, benchFall, (unsigned long) context.fallRows);
+   runBenchmark("tick_fall_from_spawn", board, &context, restoreSpawned, benchFall, 1);
+   setGameFieldMode(context.game, lockedGameFieldMode);
+   runBenchmark("tick_fall_from_spawn_locked", board, &context, restoreSpawned, benchFall, 1);
+   setGameFieldMode(context.game, compositeGameFieldMode);
+   runBenchmark("tick_landing_clear", board, &context, restoreLanding, benchTick, 1);
+   runBenchmark("hardDrop", board, &context, restoreSpawned, benchHardDrop, 1);
+   restoreHovering(&context);
+   runBenchmark("moveLeft_moveRight", board, &context, NULL, benchMoveLeftRight, 1);
+   restoreHovering(&context);
+   runBenchmark("rotateClockwise", board, &context, NULL, benchRotateClockwise, 1);
+   restoreHovering(&context);
+   runBenchmark("rotateAgainstClockwise", board, &context, NULL, benchRotateAgainstClockwise, 1);
+   restoreHovering(&context);
+   runBenchmark("getGameFieldPixel_all", board, &context, NULL, benchGetGameFieldPixel, 1);
+   runBenchmark("canActiveTetrominoRotateClockwise", board, &context, NULL, benchCanRotateClockwise, 1);
+   runBenchmark("canActiveTetrominoRotateAgainstClockwise", board, &context, NULL, benchCanRotateAgainstClockwise, 1);
+   runBenchmark("canActiveTetrominoMoveDown", board, &context, NULL, benchCanMoveDown, 1);
+   runBenchmark("lockActiveTetromino", board, &context, restoreLanding, benchLockActiveTetromino, 1);
+   runBenchmark("cleanLines", board, &context, restoreLandingAndLock, benchCleanLines, 1);
+   restoreSpawned(&context);
+   runBenchmark("findPlacements", board, &context, NULL, benchFindPlacements, 1);
+   runBenchmark("findPlacementsWithScratch", board, &context, NULL, benchFindPlacementsWithScratch, 1);
+   restoreSpawned(&context);
+   runBenchmark("evaluatePlacements", board, &context, NULL, benchEvaluatePlacements, 1);
+   runBenchmark("evaluatePlacements_fieldScan", board, &context, NULL, benchScanPlacements, 1);
+   runBenchmark("restoreGame", board, &context, NULL, benchRestoreGame, 1);
+   restoreHovering(&context);
+   runBenchmark("getGameHash", board, &context, NULL, benchGetGameHash, 1);
+   runBenchmark("getGameHash_fieldScan", board, &context, NULL, benchHashGameField, 1);
+   runBenchmark("packGameState", board, &context, NULL, benchPackGameState, 1);
+   runBenchmark("packGameState_colors", board, &context, NULL, benchPackGameStateColors, 1);
+   runBenchmark("unpackGameState_colors", board, &context, NULL, benchUnpackGameState, 1);
+   freeContext(&context);
+}
+
+// Plays `games` whole games with a cheap random policy: a random rotation and
+// column, then a hard drop. Returns the number of pieces.
+static unsigned long playRandomGames(Game* game, unsigned long games) {
+   unsigned long pieces = 0;
+   for (unsigned long i = 0; i < games; ++i) {
+      initGameInPlace(game, game->width, game->height, UINT32_MAX, NULL, getScoreAddend);
+      setTetrominoGenerator(game, bagTetrominoGenerator, benchSeed + i);
+      startGame(game);
+      while (game->status == playGameStatus) {
+         unsigned rotations = benchRandom() % tetrominoOrientationCount;
+         for (unsigned r = 0; r < rotations; ++r) {
+            rotateClockwise(game);
+         }
+         int shift = (int) (benchRandom() % game->width) - game->activeTetromino->x;
+         for (; shift < 0 && !moveLeft(game); ++shift) {
+         }
+         for (; shift > 0 && !moveRight(game); --shift) {
+         }
+         hardDrop(game, NULL);
+         ++pieces;
+      }
+   }
+   return pieces;
+}
+
+// Plays `games` whole games placing each piece at its lowest reachable
+// placement. Returns the number of pieces.
+static unsigned long playPlacementGames(Game* game, Placement* placements, unsigned long games) {
+   unsigned long pieces = 0;
+   for (unsigned long i = 0; i < games; ++i) {
+      initGameInPlace(game, game->width, game->height, UINT32_MAX, NULL, getScoreAddend);
+      setTetrominoGenerator(game, bagTetrominoGenerator, benchSeed + i);
+      startGame(game);
+      while (game->status == playGameStatus) {
+         int best = chooseLowestPlacement(game, placements);
+         if (best < 0) {
+            hardDrop(game, NULL);
+         } else {
+            placeActiveTetromino(game, placements + best);
+         }
+         ++pieces;
+      }
+   }
+   return pieces;
+}
+
+static void printThroughput(const char* name, const BenchBoard* board, unsigned long games,
+      unsigned long pieces, double elapsed) {
+   printf("%s_pieces\t%dx%d" benchBoardSuffix "\t%lu\t%.2f\t%.0f\t\n", name, board->width, board->height, pieces,
+         elapsed / pieces, pieces / elapsed * 1e9);
+   printf("%s_games\t%dx%d" benchBoardSuffix "\t%lu\t%.2f\t%.2f\t\n", name, board->width, board->height, games,
+         elapsed / games, games / elapsed * 1e9);
+}
+
+static void benchGames(const BenchBoard* board) {
+   void* memory = malloc(gameRequiredBytes(board->width, board->height));
+   Placement* placements = (Placement*) malloc(placementCapacity * sizeof(Placement));
+   Game* game = initGameInPlace(memory, board->width, board->height, UINT32_MAX, NULL, getScoreAddend);
+   unsigned long games = 1;
+   unsigned long pieces;
+   double elapsed;
+   for (;;) {
+      benchRandomState = benchSeed;
+      double start = nowNs();
+      pieces = playRandomGames(game, games);
+      elapsed = nowNs() - start;
+      if (elapsed >= benchMinimumNs) {
+         break;
+      }
+      games *= 2;
+   }
+   printThroughput("game_random_drop", board, games, pieces, elapsed);
+   games = 1;
+   for (;;) {
+      benchRandomState = benchSeed;
+      double start = nowNs();
+      pieces = playPlacementGames(game, placements, games);
+      elapsed = nowNs() - start;
+      if (elapsed >= benchMinimumNs) {
+         break;
+      }
+      games *= 2;
+   }
+   printThroughput("game_lowest_placement", board, games, pieces, elapsed);
+   free(placements);
+   free(memory);
+}
+
+int main(void) {
+   printf("benchmark\tboard\titerations\tns_per_op\tops_per_second\tnote\n");
+   for (size_t i = 0; i < sizeof(benchBoards) / sizeof(benchBoards[0]); ++i) {
+      benchOperations(benchBoards + i);
+      benchGames(benchBoards + i);
+   }
+   return 0;
+}
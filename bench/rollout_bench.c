@@ -0,0 +1,144 @@
+// Benchmark for parallel rollouts (rollout.h).
+//
+// Runs the same rollouts from one seeded 10x20 position with a greedy
+// feature policy, first the way an agent would do it outside the engine (a
+// new game from initGame per playout, a fresh placement array per move) and
+// then with rollout() for 1..N workers.
+//
+// Prints one tab-separated line per run:
+//    runner  workers  playouts  seconds  playouts_per_second  mean_pieces
+//    speedup
+// where speedup is playouts_per_second relative to the outside-engine run.
+//
+// Usage: rollout_bench [max_workers [playouts [depth]]]
+// max_workers defaults to the number of online CPUs.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rollout.h>
+
+#define benchSeed 20240601u
+#define benchDefaultPlayouts 512u
+#define benchDefaultDepth 100u
+#define benchStartPieces 10
+#define benchPlacementCapacity 1024
+
+static uint32_t getScoreAddend(int8_t cleanedLines) {
+   return (uint32_t) cleanedLines;
+}
+
+static double nowSeconds(void) {
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+// Picks the placement with the fewest holes, then the lowest stack and
+// bumpiness; ties are broken by the playout's random stream
+static int chooseGreedyPlacement(const Game* game, const Placement* placements, int count, uint64_t* random,
+      void* context) {
+   (void) context;
+   int best = -1;
+   int64_t bestCost = 0;
+   int offset = (int) (nextRolloutRandom(random) % (uint64_t) count);
+   for (int j = 0; j < count; ++j) {
+      int i = (j + offset) % count;
+      BoardFeatures features;
+      int cleanedRows = evaluatePlacement(game, placements + i, &features);
+      if (cleanedRows < 0) {
+         continue;
+      }
+      int64_t cost = 8 * (int64_t) features.holes + 2 * (int64_t) features.aggregateHeight + features.bumpiness
+            - 4 * (int64_t) cleanedRows;
+      if (best < 0 || cost < bestCost) {
+         best = i;
+         bestCost = cost;
+      }
+   }
+   return best < 0 ? 0 : best;
+}
+
+// The same playouts as rollout(), but allocating a game per playout and a
+// placement array per move
+static void runOutsideEngine(const Game* start, unsigned playouts, unsigned depth, double* meanPieces) {
+   uint64_t pieces = 0;
+   for (unsigned playout = 0; playout < playouts; ++playout) {
+      uint64_t random = benchSeed + playout * 0x9E3779B97F4A7C15ull;
+      Game* game = initGame(start->width, start->height, (int32_t) start->maxScore, NULL, getScoreAddend);
+      cloneGame(game, start);
+      game->tetrominoGenerator.state = nextRolloutRandom(&random);
+      random = nextRolloutRandom(&random);
+      for (unsigned i = 0; i < depth && game->status == playGameStatus; ++i, ++pieces) {
+         Placement* placements = (Placement*) malloc(benchPlacementCapacity * sizeof(Placement));
+         int count = findPlacements(game, placements, benchPlacementCapacity);
+         if (count <= 0) {
+            free(placements);
+            hardDrop(game, NULL);
+            ++pieces;
+            break;
+         }
+         placeActiveTetromino(game, placements + chooseGreedyPlacement(game, placements, count, &random, NULL));
+         free(placements);
+      }
+      freeGame(game);
+   }
+   *meanPieces = (double) pieces / playouts;
+}
+
+int main(int argc, char** argv) {
+   long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+   unsigned maxWorkers = argc > 1 ? (unsigned) strtoul(argv[1], NULL, 10) : (unsigned) (cpuCount > 0 ? cpuCount : 1);
+   unsigned playouts = argc > 2 ? (unsigned) strtoul(argv[2], NULL, 10) : benchDefaultPlayouts;
+   unsigned depth = argc > 3 ? (unsigned) strtoul(argv[3], NULL, 10) : benchDefaultDepth;
+   if (!maxWorkers || !playouts) {
+      fprintf(stderr, "usage: %s [max_workers [playouts [depth]]]\n", argv[0]);
+      return 1;
+   }
+
+   // a few pieces into a seeded game, so playouts start from a used board
+   Game* start = initGame(10, 20, INT32_MAX, NULL, getScoreAddend);
+   setTetrominoGenerator(start, bagTetrominoGenerator, benchSeed);
+   startGame(start);
+   Placement* placements = (Placement*) malloc(benchPlacementCapacity * sizeof(Placement));
+   uint64_t random = benchSeed;
+   for (int i = 0; i < benchStartPieces; ++i) {
+      int count = findPlacements(start, placements, benchPlacementCapacity);
+      placeActiveTetromino(start, placements + chooseGreedyPlacement(start, placements, count, &random, NULL));
+   }
+   free(placements);
+
+   printf("runner\tworkers\tplayouts\tseconds\tplayouts_per_second\tmean_pieces\tspeedup\n");
+   double meanPieces;
+   double begin = nowSeconds();
+   runOutsideEngine(start, playouts, depth, &meanPieces);
+   double elapsed = nowSeconds() - begin;
+   double baseline = playouts / elapsed;
+   printf("outside_engine\t1\t%u\t%.3f\t%.0f\t%.2f\t%.2f\n", playouts, elapsed, baseline, meanPieces, 1.0);
+   for (unsigned workers = 1; workers <= maxWorkers; ++workers) {
+      RolloutPool* pool = initRolloutPool(workers);
+      if (!pool) {
+         fprintf(stderr, "initRolloutPool failed for %u workers\n", workers);
+         return 1;
+      }
+      RolloutResults results;
+      begin = nowSeconds();
+      unsigned isFailed = rollout(pool, start, chooseGreedyPlacement, NULL, playouts, depth, benchSeed, &results);
+      elapsed = nowSeconds() - begin;
+      freeRolloutPool(pool);
+      if (isFailed) {
+         fprintf(stderr, "rollout failed for %u workers\n", workers);
+         return 1;
+      }
+      double perSecond = playouts / elapsed;
+      printf("rollout\t%u\t%u\t%.3f\t%.0f\t%.2f\t%.2f\n", workers, playouts, elapsed, perSecond,
+            results.meanPieces, perSecond / baseline);
+      fflush(stdout);
+   }
+   freeGame(start);
+   return 0;
+}
@@ -0,0 +1,174 @@
+// Load generator for the multi-core game server (game_server.h).
+//
+// For 1..N workers runs the same number of 10x20 games with one producer
+// thread per worker pushing random inputs into the worker's shard of games.
+// Ended games are restarted, and every game ticks once per 50 ms, as a fast
+// level would.
+//
+// Prints one tab-separated line per worker count:
+//    workers  games  seconds  inputs_per_second  ticks_per_second  speedup
+// where speedup is inputs_per_second relative to the single worker run.
+// Ticks are paced by the clock, so they are reported but not scaled.
+//
+// Usage: server_bench [max_workers [games [seconds]]]
+// max_workers defaults to, and is capped at, the number of online CPUs:
+// more workers than CPUs only measure the scheduler.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <game_server.h>
+
+#define benchSeed 20240601u
+#define benchDefaultGames 4096u
+#define benchDefaultSeconds 1.0
+#define benchTickNanoseconds 50000000u // 20 ticks per second per game
+
+typedef struct tagBenchProducer {
+   GameServer* server;
+   thrd_t thread;
+   unsigned firstGame;
+   unsigned lastGame;
+   uint64_t random;
+   const atomic_bool* stopping;
+} BenchProducer;
+
+static uint32_t getScoreAddend(int8_t cleanedLines) {
+   return (uint32_t) cleanedLines;
+}
+
+static double nowSeconds(void) {
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+static uint64_t nextRandom(uint64_t* state) {
+   // xorshift64*
+   *state ^= *state >> 12;
+   *state ^= *state << 25;
+   *state ^= *state >> 27;
+   return *state * 2685821657736338717u;
+}
+
+static int runProducer(void* argument) {
+   BenchProducer* producer = (BenchProducer*) argument;
+   while (!atomic_load_explicit(producer->stopping, memory_order_relaxed)) {
+      unsigned isPushed = 0;
+      for (unsigned i = producer->firstGame; i < producer->lastGame; ++i) {
+         // every input except noneInput and tickInput: ticks come from the server
+         static const GameInput inputs[] = {moveLeftInput, moveRightInput, rotateClockwiseInput,
+               rotateAgainstClockwiseInput, softDropInput, hardDropInput};
+         GameInput input = inputs[nextRandom(&producer->random) % (sizeof(inputs) / sizeof(inputs[0]))];
+         isPushed |= !pushGameServerInput(producer->server, i, input);
+      }
+      if (!isPushed) {
+         thrd_yield();
+      }
+   }
+   return 0;
+}
+
+static unsigned runBench(unsigned workerCount, unsigned gameCount, double seconds, double baseline,
+      double* inputsPerSecond) {
+   GameServerConfig config = {
+      .workerCount = workerCount,
+      .gameCount = gameCount,
+      .width = 10,
+      .height = 20,
+      .maxScore = INT32_MAX,
+      .getScoreAddend = getScoreAddend,
+      .generatorType = bagTetrominoGenerator,
+      .seed = benchSeed,
+      .tickNanoseconds = benchTickNanoseconds,
+      .restartEndedGames = 1,
+   };
+   GameServer* server = startGameServer(&config);
+   if (!server) {
+      fprintf(stderr, "startGameServer failed for %u workers\n", workerCount);
+      return 1;
+   }
+   atomic_bool stopping;
+   atomic_init(&stopping, 0);
+   BenchProducer* producers = (BenchProducer*) calloc(workerCount, sizeof(BenchProducer));
+   if (!producers) {
+      freeGameServer(server);
+      return 1;
+   }
+   GameServerStats before;
+   getGameServerStats(server, &before);
+   double start = nowSeconds();
+   unsigned startedProducers = 0;
+   for (; startedProducers < workerCount; ++startedProducers) {
+      BenchProducer* producer = producers + startedProducers;
+      producer->server = server;
+      // the same sharding as the server, so a producer feeds one worker
+      producer->firstGame = (unsigned) ((uint64_t) gameCount * startedProducers / workerCount);
+      producer->lastGame = (unsigned) ((uint64_t) gameCount * (startedProducers + 1) / workerCount);
+      producer->random = benchSeed + startedProducers * 0x9E3779B97F4A7C15u;
+      producer->stopping = &stopping;
+      if (thrd_create(&producer->thread, runProducer, producer) != thrd_success) {
+         break;
+      }
+   }
+   struct timespec sleep = {(time_t) seconds, (long) ((seconds - (double) (time_t) seconds) * 1e9)};
+   if (startedProducers == workerCount) {
+      thrd_sleep(&sleep, NULL);
+   }
+   atomic_store_explicit(&stopping, 1, memory_order_relaxed);
+   for (unsigned i = 0; i < startedProducers; ++i) {
+      thrd_join(producers[i].thread, NULL);
+   }
+   stopGameServer(server);
+   double elapsed = nowSeconds() - start;
+   GameServerStats after;
+   getGameServerStats(server, &after);
+   freeGameServer(server);
+   free(producers);
+   if (startedProducers != workerCount) {
+      fprintf(stderr, "thrd_create failed for %u workers\n", workerCount);
+      return 1;
+   }
+
+   *inputsPerSecond = (double) (after.appliedInputs - before.appliedInputs) / elapsed;
+   double ticks = (double) (after.ticks - before.ticks) / elapsed;
+   printf("%u\t%u\t%.3f\t%.0f\t%.0f\t%.2f\n", workerCount, gameCount, elapsed, *inputsPerSecond, ticks,
+         baseline > 0 ? *inputsPerSecond / baseline : 1.0);
+   fflush(stdout);
+   return 0;
+}
+
+int main(int argc, char** argv) {
+   long onlineCpus = sysconf(_SC_NPROCESSORS_ONLN);
+   unsigned cpuCount = onlineCpus > 0 ? (unsigned) onlineCpus : 1;
+   unsigned maxWorkers = argc > 1 ? (unsigned) strtoul(argv[1], NULL, 10) : cpuCount;
+   unsigned gameCount = argc > 2 ? (unsigned) strtoul(argv[2], NULL, 10) : benchDefaultGames;
+   double seconds = argc > 3 ? strtod(argv[3], NULL) : benchDefaultSeconds;
+   if (!maxWorkers || gameCount < maxWorkers || seconds <= 0) {
+      fprintf(stderr, "usage: %s [max_workers [games [seconds]]]\n", argv[0]);
+      return 1;
+   }
+   if (maxWorkers > cpuCount) {
+      fprintf(stderr, "%s: capping %u workers at %u online CPUs\n", argv[0], maxWorkers, cpuCount);
+      maxWorkers = cpuCount;
+   }
+
+   printf("workers\tgames\tseconds\tinputs_per_second\tticks_per_second\tspeedup\n");
+   double baseline = 0;
+   for (unsigned workers = 1; workers <= maxWorkers; ++workers) {
+      double inputsPerSecond;
+      if (runBench(workers, gameCount, seconds, baseline, &inputsPerSecond)) {
+         return 1;
+      }
+      if (workers == 1) {
+         baseline = inputsPerSecond;
+      }
+   }
+   return 0;
+}
@@ -13,6 +13,15 @@ GetScoreAddendFunction *const ourGetScoreAddendFunction;
 // need atomic because now it is immutable).
 Game* game = NULL;
 
+// size of one field pixel in window pixels
+#define PIXEL_SIZE 24
+// next tetromino and score are drawn to the right of the field
+#define SIDE_PANEL_WIDTH (5 * PIXEL_SIZE)
+
+// changes since the last repaint. The row mask fits any field height
+DirtyRegion dirtyRegion;
+uint64_t dirtyRows[dirtyRowWords(gameCoordinateMax)];
+
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
@@ -22,6 +31,8 @@ void handler_keyDown(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 void handler_timer(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+void invalidateDirtyRegion(HWND hWnd);
+
 int main() {
    // GetModuleHandleW in a real app will be also needed or use cl compiler with WinMain-like entry point
 
@@ -35,6 +46,8 @@ int main() {
 
    // start game
    startGame(game);
+   // the first WM_PAINT draws the whole window, so skip the initial changes
+   getDirtyRegion(game, &dirtyRegion, dirtyRows);
 
    // SetTimer call
    SetTimer(hWnd, 1, 500, NULL);
@@ -75,8 +88,11 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
 }
 
 void handler_paint(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+   // BeginPaint gives PAINTSTRUCT::rcPaint: only rows inside it need to be drawn,
+   // everything else is clipped by GDI anyway
    for (int8_t y = game->height - 1; y >= 0; --y) {
       int8_t realY = game->height - 1 - y;
+      // skip rows outside of rcPaint: realY * PIXEL_SIZE .. (realY + 1) * PIXEL_SIZE
       for (int8_t x = 0; x < game->width; ++x) {
          TetrominoPixel tetrominoPixel = flatArrayAs2D(game->gameField, x, y, game->width);
          // if pixel not empty (not 0)
@@ -97,29 +113,26 @@ void handler_paint(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
 }
 
 void handler_keyDown(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
-   unsigned isGameFieldChange;
    // check game->status
    if (game->status == playGameStatus) {
       switch (wParam) {
          case VK_LEFT:
          case 0x41: // A
-            isGameFieldChange = moveLeft(game);
+            moveLeft(game);
             break;
          case VK_RIGHT:
          case 0x44: // D
-            isGameFieldChange = moveRight(game);
+            moveRight(game);
             break;
          case 0x51: // Q
-            isGameFieldChange = rotateAgainstClockwise(game);
+            rotateAgainstClockwise(game);
             break;
          case 0x45: // E
-            isGameFieldChange = rotateClockwise(game);
+            rotateClockwise(game);
             break;
       }
-      if (!isGameFieldChange) {
-         // send WM_PAINT
-         InvalidateRect(hWnd, NULL, FALSE);
-      }
+      // failed moves change nothing, so nothing will be invalidated
+      invalidateDirtyRegion(hWnd);
    }
 }
 
@@ -127,10 +140,38 @@ void handler_timer(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
    unsigned status = tick(game);
    if (status == 2 || status == 3) {
       // game ends then kill the timer
-   } else {
-      // success or fail (but we need to update screen because of 
-      //   nextTetromino move to activeTetramino and because
-      //   the new nextTetromino was generated)
-      InvalidateRect(hWnd, NULL, FALSE);
+   }
+   // tick can move tetromino down, lock it, clean lines, take the next
+   // tetromino and end the game: the dirty region covers all of that
+   invalidateDirtyRegion(hWnd);
+}
+
+void invalidateDirtyRegion(HWND hWnd) {
+   getDirtyRegion(game, &dirtyRegion, dirtyRows);
+   const DirtyRegion* region = &dirtyRegion;
+   // send WM_PAINT only for changed rows. Adjacent rows are merged into one rect
+   for (int8_t y = 0; y < game->height; ++y) {
+      if (!isDirtyRow(region, y)) {
+         continue;
+      }
+      int8_t topY = y;
+      while (topY + 1 < game->height && isDirtyRow(region, topY + 1)) {
+         ++topY;
+      }
+      RECT rect;
+      rect.left = 0;
+      rect.right = game->width * PIXEL_SIZE;
+      rect.top = (game->height - 1 - topY) * PIXEL_SIZE;
+      rect.bottom = (game->height - y) * PIXEL_SIZE;
+      InvalidateRect(hWnd, &rect, FALSE);
+      y = topY;
+   }
+   if (region->nextTetrominoChanged || region->scoreChanged) {
+      RECT rect;
+      rect.left = game->width * PIXEL_SIZE;
+      rect.right = game->width * PIXEL_SIZE + SIDE_PANEL_WIDTH;
+      rect.top = 0;
+      rect.bottom = game->height * PIXEL_SIZE;
+      InvalidateRect(hWnd, &rect, FALSE);
    }
 }
@@ -1,8 +1,20 @@
 #ifndef MIROSLAVBEL_TETRIS_ENGINE_ENGINE_H
 #define MIROSLAVBEL_TETRIS_ENGINE_ENGINE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+/*!
+ * \brief Спецификатор функций движка.
+ *
+ * Пуст при обычной сборке движка в объектный файл. engine_fixed.h
+ * определяет его как \a static \a inline, чтобы все функции движка
+ * попадали в каждую единицу трансляции, которая его включает.
+ */
+#ifndef TETRIS_ENGINE_API
+#define TETRIS_ENGINE_API
+#endif
+
 /*! \mainpage tetris-engine
  *
  * Небольшой движок для тетриса.
@@ -18,6 +30,8 @@
  * Функции, представленные в tetris-engine можно поделить на следующие группы:
  *   - Создание и деалокация игры
  *     - #initGame
+ *     - #gameRequiredBytes
+ *     - #initGameInPlace
  *     - #startGame
  *     - #freeGame
  *   - Обработка ввода пользователя
@@ -27,8 +41,70 @@
  *     - #rotateAgainstClockwise
  *   - Тик
  *     - #tick
+ *   - Падение тетрамино
+ *     - #hardDrop
+ *     - #softDrop
  *   - Доступ к игровому стакану
  *     - #getGameFieldPixel
+ *     - #setGameFieldMode
+ *     - #renderField
+ *     - #getDirtyRegion
+ *   - События игры
+ *     - #drainGameEvents
+ *   - Публикация игры для других потоков (только при сборке с
+ * TETRIS_ENGINE_GAME_VIEW)
+ *     - #attachGameView
+ *     - #readGameView
+ *     - #getGameViewVersion
+ *     - #detachGameView
+ *   - Генерация следующих тетрамино
+ *     - #setTetrominoGenerator
+ *     - #setTetrominoSequence
+ *     - #getPreviewTetromino
+ *   - Поиск положений активного тетрамино
+ *     - #findPlacements
+ *     - #placementScratchBytes
+ *     - #findPlacementsWithScratch
+ *     - #placeActiveTetromino
+ *     - #evaluatePlacement
+ *   - Ввод как данные
+ *     - #applyInput
+ *   - Хеш позиции
+ *     - #getGameHash
+ *   - Запись и воспроизведение игр
+ *     - #startRecordedGame
+ *     - #recordInput
+ *     - #finishGameRecording
+ *     - #freeGameRecorder
+ *     - #replayGameLog
+ *   - Упакованные состояния игры
+ *     - #packedGameStateMaxSize
+ *     - #packGameState
+ *     - #unpackGameState
+ *     - #startGameStateArchive
+ *     - #appendGameState
+ *     - #flushGameStateArchive
+ *     - #finishGameStateArchive
+ *     - #freeGameStateArchiveWriter
+ *     - #openGameStateArchive
+ *     - #getArchivedGameState
+ *   - Снимки состояния игры
+ *     - #gameSnapshotSize
+ *     - #snapshotGame
+ *     - #restoreGame
+ *     - #cloneGame
+ *   - Пакетная обработка игр
+ *     - #initGameBatch
+ *     - #startGameBatch
+ *     - #stepGameBatch
+ *     - #freeGameBatch
+ *   - Счетчики горячих путей (только при сборке с TETRIS_ENGINE_STATS)
+ *     - #getGameStats
+ *     - #resetGameStats
+ * 
+ * Для стакана фиксированного размера движок можно подключить без объектного
+ * файла через engine_fixed.h: размеры стакана становятся константами времени
+ * компиляции.
  * 
  * Для доступа к игровому стакану (#Game::gameField) можно использовать макрос
  * #flatArrayAs2D или memory-safe функцию #getGameFieldPixel. Для доступа к
@@ -39,7 +115,9 @@
  * \note Так как #TetrominoPixel не является атомарным, в многониточной
  * программе при доступе к игровому стакану и следующему тетрамино нужно
  * гарантировать, что никакая из функций не работает с игрой в данный момент
- * времени.
+ * времени. В сборке с TETRIS_ENGINE_GAME_VIEW другие потоки могут вместо
+ * этого читать опубликованную копию игры (#attachGameView, #readGameView)
+ * без блокировок.
  * 
  * \note Данные в игровом стакане и следующем тетрамино являются
  * консистентными между вызовами функций.
@@ -87,6 +165,105 @@
  */
 #define tetrominoArrayMaxSize 16
 
+/*!
+ * \brief Количество поворотов тетрамино.
+ *
+ * \see #ActiveTetromino::orientation
+ */
+#define tetrominoOrientationCount 4
+
+/*!
+ * \brief Количество служебных столбцов слева и справа и служебных строк снизу
+ * и сверху битовой доски #Game::occupancy.
+ *
+ * Равно #tetrominoMaxSize. Этого достаточно, чтобы любая проверка коллизий
+ * активного тетрамино (в том числе при его сдвиге на один пиксел) не выходила
+ * за пределы битовой доски.
+ */
+#define occupancyPadding 4
+
+/*!
+ * \brief Длина кольцевой очереди следующих тетрамино #Game::tetrominoQueue.
+ *
+ * Очередь пополняется пачками: когда в ней остается меньше
+ * #tetrominoPreviewLength тетрамино, она заполняется целиком.
+ */
+#define tetrominoQueueCapacity 16
+
+/*!
+ * \brief Количество следующих тетрамино, которые всегда доступны через
+ * #getPreviewTetromino.
+ *
+ * Не больше #tetrominoQueueCapacity.
+ */
+#define tetrominoPreviewLength 8
+
+/*!
+ * \brief Длина кольцевой очереди событий #Game::eventQueue.
+ */
+#define gameEventQueueCapacity 32
+
+/*!
+ * \brief Количество форм в таблице форм #Game::shapeTable.
+ */
+#define tetrominoShapeCapacity 16
+
+/*!
+ * \brief Количество ячеек хеш-индекса таблицы форм.
+ *
+ * Степень двойки, вдвое больше #tetrominoShapeCapacity.
+ */
+#define tetrominoShapeIndexSize 32
+
+/*!
+ * \brief Номер формы тетрамино, которой нет в таблице форм (таблица
+ * заполнена).
+ */
+#define noTetrominoShape 0xFF
+
+/*!
+ * \brief Координата или размер в пикселах игрового стакана.
+ *
+ * По умолчанию \a int8_t, и ширина и высота стакана не больше
+ * \a INT8_MAX. При сборке с макросом TETRIS_ENGINE_WIDE_COORDINATES -
+ * \a int16_t, и они не больше \a INT16_MAX. Макрос влияет на размер
+ * #Game и должен быть одинаковым при сборке движка и всех единиц
+ * трансляции, использующих engine.h.
+ *
+ * \see #gameCoordinateMax
+ */
+#ifdef TETRIS_ENGINE_WIDE_COORDINATES
+typedef int16_t GameCoordinate;
+#else
+typedef int8_t GameCoordinate;
+#endif
+
+/*!
+ * \brief Максимальное значение #GameCoordinate и максимальные ширина и
+ * высота игрового стакана.
+ */
+#ifdef TETRIS_ENGINE_WIDE_COORDINATES
+#define gameCoordinateMax INT16_MAX
+#else
+#define gameCoordinateMax INT8_MAX
+#endif
+
+/*!
+ * \brief Количество 64-битных слов в #DirtyRegion::rows.
+ *
+ * \param[in] height высота игрового стакана
+ * \return количество слов
+ */
+#define dirtyRowWords(height) (((size_t) (height) + 63) / 64)
+
+/*!
+ * \brief Изменилась ли строка \a y игрового стакана.
+ * \param[in] region указатель на #DirtyRegion
+ * \param[in] y y-координата строки
+ * \return \a 1 если строка изменилась, иначе \a 0
+ */
+#define isDirtyRow(region, y) ((unsigned) ((region)->rows[(y) / 64] >> ((y) % 64)) & 1u)
+
 /*!
  * \brief Пиксел тетрамино.
  * 
@@ -156,6 +333,100 @@ typedef struct tagNextTetromino {
  */
 typedef void GetNextTetrominoFunction(NextTetromino* nextTetromino);
 
+/*!
+ * \brief Виды стандартных тетрамино, которые создают встроенные генераторы.
+ *
+ * Пикселы тетрамино вида \a kind равны \a kind + 1.
+ *
+ * \see #setTetrominoGenerator
+ */
+typedef enum tagTetrominoKind {
+   iTetromino,
+   oTetromino,
+   tTetromino,
+   sTetromino,
+   zTetromino,
+   jTetromino,
+   lTetromino,
+   tetrominoKindCount, ///< Количество видов.
+} TetrominoKind;
+
+/*!
+ * \brief Генераторы следующих тетрамино.
+ */
+typedef enum tagTetrominoGeneratorType {
+   functionTetrominoGenerator, ///< #Game::getNextTetromino. Используется по умолчанию.
+   /*!
+    * \brief Случайная перестановка всех #tetrominoKindCount видов, затем
+    * следующая и т. д.
+    */
+   bagTetrominoGenerator,
+   uniformTetrominoGenerator,  ///< Каждый вид выбирается равновероятно.
+   sequenceTetrominoGenerator, ///< Заданная последовательность видов по кругу.
+   /*!
+    * \brief Тетрамино, записанные в журнал игры. Используется только
+    * #replayGameLog.
+    */
+   logTetrominoGenerator,
+} TetrominoGeneratorType;
+
+/*!
+ * \brief Состояние генератора следующих тетрамино.
+ *
+ * \see #setTetrominoGenerator
+ * \see #setTetrominoSequence
+ */
+typedef struct tagTetrominoGenerator {
+   TetrominoGeneratorType type; ///< Генератор.
+   uint64_t state;              ///< Состояние генератора случайных чисел.
+   /*!
+    * \brief Текущая перестановка #bagTetrominoGenerator.
+    */
+   uint8_t bag[tetrominoKindCount];
+   /*!
+    * \brief Индекс следующего вида в #bag. Если равен #tetrominoKindCount,
+    * то нужна новая перестановка.
+    */
+   uint8_t bagPosition;
+   /*!
+    * \brief Последовательность видов #sequenceTetrominoGenerator.
+    *
+    * \note Массив принадлежит пользователю.
+    */
+   const uint8_t* sequence;
+   unsigned sequenceLength;   ///< Длина #sequence.
+   unsigned sequencePosition; ///< Индекс следующего вида в #sequence.
+} TetrominoGenerator;
+
+/*!
+ * \brief Кольцевая очередь следующих тетрамино.
+ *
+ * Первый элемент очереди - #Game::nextTetromino: его #NextTetromino::pixels
+ * указывает на пикселы этого элемента.
+ */
+typedef struct tagTetrominoQueue {
+   /*!
+    * \brief Пикселы тетрамино очереди.
+    *
+    * \note Длина одномерного массива равна #tetrominoQueueCapacity *
+    * #tetrominoArrayMaxSize. Элемент \a i занимает #tetrominoArrayMaxSize
+    * пикселов, начиная с \a i * #tetrominoArrayMaxSize.
+    */
+   TetrominoPixelArray const pixels;
+   /*!
+    * \brief #NextTetromino::size тетрамино очереди.
+    *
+    * \note Длина одномерного массива равна #tetrominoQueueCapacity.
+    */
+   int8_t* const sizes;
+   uint8_t head;  ///< Индекс первого элемента.
+   uint8_t count; ///< Количество элементов.
+   /*!
+    * \brief Количество тетрамино, добавленных в очередь с начала игры.
+    */
+   uint32_t total;
+} TetrominoQueue;
+
 /*!
  * \brief Активное тетрамино.
  */
@@ -175,14 +446,14 @@ typedef struct tagActiveTetromino {
     * 
     * \warning Может быть отрицательным.
     */
-   int8_t x;
+   GameCoordinate x;
    /*!
     * \brief Смещение начала координат массива #pixels по оси \a y относительно
     * начала координат игрового стакана.
     * 
     * \warning Может быть отрицательным.
     */
-   int8_t y;
+   GameCoordinate y;
    /*!
     * \brief Одномерный массив пикселов тетрамино.
     *
@@ -191,10 +462,125 @@ typedef struct tagActiveTetromino {
     * \note Длина одномерного массива равна #tetrominoArrayMaxSize. Для доступа
     * как к двухмерному массиву используйте макрос #flatArrayAs2D. Ширина и
     * высота двухмерного массива равна #tetrominoMaxSize.
+    * 
+    * \warning Указывает внутрь #orientationPixels и меняется при каждом
+    * повороте тетрамино.
     */
    TetrominoPixelArray pixels;
+   /*!
+    * \brief Одномерный массив пикселов всех поворотов тетрамино.
+    *
+    * Повороты вычисляются один раз, когда тетрамино становится активным.
+    * Пикселы поворота с номером \a i начинаются с индекса
+    * \a i * #tetrominoArrayMaxSize. #pixels всегда указывает на пикселы
+    * текущего поворота #orientation.
+    *
+    * \note Длина одномерного массива равна #tetrominoOrientationCount *
+    * #tetrominoArrayMaxSize.
+    */
+   TetrominoPixelArray orientationPixels;
+   /*!
+    * \brief Номер текущего поворота.
+    *
+    * Может принимать значения [0 .. #tetrominoOrientationCount). Поворот по
+    * часовой стрелке увеличивает номер на \a 1, против часовой стрелки
+    * уменьшает на \a 1 (по модулю #tetrominoOrientationCount). Тетрамино,
+    * полученное от #GetNextTetrominoFunction, имеет номер поворота \a 0.
+    */
+   int8_t orientation;
+   /*!
+    * \brief Битовые маски занятых пикселов каждого поворота.
+    *
+    * Бит с номером \a y * #tetrominoMaxSize + \a x установлен, если пиксел
+    * \a x:y занят. Таким образом каждые #tetrominoMaxSize бит маски образуют
+    * маску одной строки тетрамино.
+    */
+   uint16_t masks[tetrominoOrientationCount];
+   /*!
+    * \brief Битовые маски пикселов, которые должны быть свободны для поворота
+    * по часовой стрелке из каждого поворота.
+    *
+    * Содержат все пикселы, через которые проходят пикселы тетрамино при
+    * повороте. Нумерация бит такая же, как у #masks.
+    */
+   uint16_t clockwiseSweepMasks[tetrominoOrientationCount];
+   /*!
+    * \brief Битовые маски пикселов, которые должны быть свободны для поворота
+    * против часовой стрелки из каждого поворота.
+    *
+    * Нумерация бит такая же, как у #masks.
+    *
+    * \see #clockwiseSweepMasks
+    */
+   uint16_t againstClockwiseSweepMasks[tetrominoOrientationCount];
+   /*!
+    * \brief Нижний занятый пиксел каждого столбца каждого поворота.
+    *
+    * Элемент [\a i][\a x] равен y-координате самого нижнего занятого пиксела
+    * столбца \a x поворота \a i или \a -1, если столбец пуст.
+    */
+   int8_t columnBottoms[tetrominoOrientationCount][tetrominoMaxSize];
+   /*!
+    * \brief Номер формы тетрамино в #Game::shapeTable или
+    * #noTetrominoShape.
+    *
+    * Тетрамино с одинаковыми #size и занятыми пикселами имеют одну форму
+    * независимо от значений пикселов.
+    */
+   uint8_t shape;
 } ActiveTetromino;
 
+/*!
+ * \brief Прямоугольник занятых пикселов одного поворота тетрамино в
+ * координатах массива пикселов тетрамино.
+ */
+typedef struct tagTetrominoBounds {
+   int8_t x;      ///< левый занятый столбец
+   int8_t y;      ///< нижняя занятая строка
+   int8_t width;  ///< ширина
+   int8_t height; ///< высота
+} TetrominoBounds;
+
+/*!
+ * \brief Данные формы тетрамино, которые не зависят от значений пикселов.
+ *
+ * Вычисляются один раз для каждой новой формы и копируются в
+ * #ActiveTetromino, когда тетрамино этой формы становится активным.
+ *
+ * \see #TetrominoShapeTable
+ */
+typedef struct tagTetrominoShape {
+   int8_t size;                                                         ///< #ActiveTetromino::size
+   uint16_t masks[tetrominoOrientationCount];                           ///< #ActiveTetromino::masks
+   uint16_t clockwiseSweepMasks[tetrominoOrientationCount];             ///< #ActiveTetromino::clockwiseSweepMasks
+   uint16_t againstClockwiseSweepMasks[tetrominoOrientationCount];      ///< #ActiveTetromino::againstClockwiseSweepMasks
+   int8_t columnBottoms[tetrominoOrientationCount][tetrominoMaxSize];   ///< #ActiveTetromino::columnBottoms
+   TetrominoBounds bounds[tetrominoOrientationCount];                   ///< Занятые пикселы каждого поворота.
+} TetrominoShape;
+
+/*!
+ * \brief Таблица форм тетрамино игры.
+ *
+ * Форма ищется по хешу #size и маски поворота \a 0 в открытой адресации
+ * (#index). Формы не удаляются: когда таблица заполнена, новые формы
+ * получают номер #noTetrominoShape и вычисляются заново при каждом
+ * появлении.
+ */
+typedef struct tagTetrominoShapeTable {
+   /*!
+    * \brief Формы в порядке добавления. Номер формы - индекс в массиве.
+    *
+    * \note Длина массива равна #tetrominoShapeCapacity.
+    */
+   TetrominoShape* const shapes;
+   uint8_t count;  ///< Количество форм.
+   /*!
+    * \brief Хеш-индекс: номер формы или #noTetrominoShape для пустой
+    * ячейки.
+    */
+   uint8_t index[tetrominoShapeIndexSize];
+} TetrominoShapeTable;
+
 /*!
  * \brief Состояния игры.
  */
@@ -218,6 +604,337 @@ typedef enum tagGameStatus {
    endPlayerLoose,
 } GameStatus;
 
+/*!
+ * \brief Режимы хранения активного тетрамино в игровом стакане.
+ * 
+ * \see #setGameFieldMode
+ */
+typedef enum tagGameFieldMode {
+   /*!
+    * \brief #Game::gameField содержит и зафиксированные пикселы, и пикселы
+    * активного тетрамино. Каждое перемещение активного тетрамино стирает его
+    * из стакана и рисует заново.
+    */
+   compositeGameFieldMode,
+   /*!
+    * \brief #Game::gameField содержит только зафиксированные пикселы.
+    * Перемещения активного тетрамино не обращаются к стакану, пикселы
+    * записываются в него только при фиксации. Стакан вместе с активным
+    * тетрамино можно получить с помощью #renderField.
+    */
+   lockedGameFieldMode,
+} GameFieldMode;
+
+/*!
+ * \brief Ввод пользователя.
+ *
+ * Позволяет передавать ввод как данные, например, в #applyInput и
+ * #stepGameBatch.
+ */
+typedef enum tagGameInput {
+   noneInput,                   ///< Ничего не делать.
+   moveLeftInput,               ///< #moveLeft
+   moveRightInput,              ///< #moveRight
+   rotateClockwiseInput,        ///< #rotateClockwise
+   rotateAgainstClockwiseInput, ///< #rotateAgainstClockwise
+   tickInput,                   ///< #tick
+   softDropInput,               ///< #softDrop на одну строку
+   hardDropInput,               ///< #hardDrop
+   gameInputCount,              ///< Количество видов ввода.
+} GameInput;
+
+/*!
+ * \brief Прямоугольник, который занимают пикселы активного тетрамино.
+ *
+ * Координаты игрового стакана. Прямоугольник может выходить за верх
+ * стакана. Если #width равна \a 0, то активного тетрамино нет.
+ */
+typedef struct tagTetrominoRect {
+   GameCoordinate x;      ///< x-координата левого столбца
+   GameCoordinate y;      ///< y-координата нижней строки
+   GameCoordinate width;  ///< ширина в пикселах
+   GameCoordinate height; ///< высота в пикселах
+} TetrominoRect;
+
+/*!
+ * \brief Изменения игры, которые нужно отобразить.
+ *
+ * Изменения накапливаются между вызовами #getDirtyRegion.
+ *
+ * \see #getDirtyRegion
+ */
+typedef struct tagDirtyRegion {
+   /*!
+    * \brief Битовая маска измененных строк игрового стакана вместе с
+    * активным тетрамино (см. #renderField).
+    *
+    * Бит \a y % 64 слова \a y / 64 соответствует строке \a y. Включает
+    * строки #oldActiveTetromino и #newActiveTetromino. Для проверки
+    * строки используйте макрос #isDirtyRow.
+    *
+    * \note Длина массива равна #dirtyRowWords(#Game::height).
+    */
+   uint64_t* rows;
+   /*!
+    * \brief Прямоугольник активного тетрамино на момент прошлого вызова
+    * #getDirtyRegion.
+    */
+   TetrominoRect oldActiveTetromino;
+   TetrominoRect newActiveTetromino; ///< Прямоугольник активного тетрамино сейчас.
+   uint8_t nextTetrominoChanged;     ///< Изменились ли следующие тетрамино.
+   uint8_t scoreChanged;             ///< Изменилось ли #Game::score.
+   uint8_t statusChanged;            ///< Изменилось ли #Game::status.
+} DirtyRegion;
+
+/*!
+ * \brief Виды событий игры.
+ *
+ * \see #GameEvent
+ */
+typedef enum tagGameEventType {
+   /*!
+    * \brief Активное тетрамино появилось над игровым стаканом (#startGame
+    * или после фиксации предыдущего).
+    */
+   spawnGameEvent,
+   lockGameEvent,      ///< Активное тетрамино зафиксировано.
+   lineClearGameEvent, ///< Заполненные строки очищены.
+   /*!
+    * \brief Игра закончена: достигнут максимум очков или игрок проиграл.
+    */
+   gameOverGameEvent,
+} GameEventType;
+
+/*!
+ * \brief Событие игры.
+ *
+ * Поля, не относящиеся к виду события, равны \a 0.
+ *
+ * \see #drainGameEvents
+ */
+typedef struct tagGameEvent {
+   GameEventType type; ///< Вид события.
+   /*!
+    * \brief #Game::score в момент события.
+    *
+    * Очки за очищенные строки начисляются после #lineClearGameEvent, поэтому
+    * видны в следующем за ним событии.
+    */
+   uint32_t score;
+   /*!
+    * \brief #ActiveTetromino::x для #spawnGameEvent и #lockGameEvent.
+    */
+   GameCoordinate x;
+   /*!
+    * \brief #ActiveTetromino::y для #spawnGameEvent и #lockGameEvent,
+    * нижняя очищенная строка для #lineClearGameEvent.
+    */
+   GameCoordinate y;
+   int8_t size;        ///< #ActiveTetromino::size для #spawnGameEvent и #lockGameEvent.
+   /*!
+    * \brief #ActiveTetromino::shape для #spawnGameEvent и #lockGameEvent.
+    */
+   uint8_t shape;
+   int8_t orientation; ///< #ActiveTetromino::orientation для #lockGameEvent.
+   int8_t clearedRows; ///< Количество очищенных строк для #lineClearGameEvent.
+   /*!
+    * \brief Очищенные строки для #lineClearGameEvent: бит \a i
+    * соответствует строке #y + \a i (до очистки).
+    */
+   uint8_t clearedRowMask;
+   /*!
+    * \brief #Game::status для #gameOverGameEvent: #endMaxScoreStatus или
+    * #endPlayerLoose.
+    */
+   GameStatus status;
+} GameEvent;
+
+/*!
+ * \brief Кольцевая очередь событий игры.
+ *
+ * Движок добавляет события в конец, #drainGameEvents забирает их из
+ * начала. Если очередь заполнена, новые события отбрасываются и
+ * считаются в #droppedEvents.
+ */
+typedef struct tagGameEventQueue {
+   /*!
+    * \brief События.
+    *
+    * \note Длина массива равна #gameEventQueueCapacity.
+    */
+   GameEvent* const events;
+   uint8_t head;           ///< Индекс первого события.
+   uint8_t count;          ///< Количество событий.
+   /*!
+    * \brief Количество событий, отброшенных из-за заполненной очереди, с
+    * создания игры.
+    */
+   uint32_t droppedEvents;
+} GameEventQueue;
+
+/*!
+ * \brief Признаки зафиксированных пикселов игрового стакана для оценки
+ * положений.
+ *
+ * Поддерживаются движком при фиксации тетрамино и очистке строк, поэтому
+ * пересчитывать их по #getGameFieldPixel не нужно. Высоты столбцов лежат в
+ * #Game::columnHeights.
+ *
+ * \see #Game::boardFeatures
+ * \see #evaluatePlacement
+ */
+typedef struct tagBoardFeatures {
+   uint32_t aggregateHeight; ///< Сумма #Game::columnHeights.
+   GameCoordinate maxHeight; ///< Наибольшая из #Game::columnHeights.
+   uint32_t lockedPixels;    ///< Количество зафиксированных пикселов.
+   /*!
+    * \brief Количество пустых пикселов ниже вершины своего столбца.
+    *
+    * Равно #aggregateHeight - #lockedPixels.
+    */
+   uint32_t holes;
+   /*!
+    * \brief Сумма модулей разностей высот соседних столбцов.
+    */
+   uint32_t bumpiness;
+   /*!
+    * \brief Количество соседних по горизонтали пар пикселов, из которых
+    * занят ровно один.
+    *
+    * Считается по всем строкам игрового стакана, стены считаются занятыми.
+    * Поэтому пустая строка дает \a 2, а заполненная - \a 0.
+    */
+   uint32_t rowTransitions;
+   /*!
+    * \brief Сумма глубин колодцев.
+    *
+    * Глубина колодца столбца - на сколько его высота меньше высоты более
+    * низкого из соседних столбцов (или \a 0). Стены считаются бесконечно
+    * высокими.
+    */
+   uint32_t wellDepths;
+} BoardFeatures;
+
+#ifdef TETRIS_ENGINE_GAME_VIEW
+/*!
+ * \brief Опубликованная копия игры.
+ *
+ * Заполняется функцией #readGameView. Все поля относятся к одному и тому же
+ * состоянию игры.
+ *
+ * Существует только при сборке с макросом TETRIS_ENGINE_GAME_VIEW (например,
+ * \a -DTETRIS_ENGINE_GAME_VIEW). Публикация использует атомарные операции
+ * C11 (stdatomic.h), без макроса движок их не требует.
+ */
+typedef struct tagGameView {
+   /*!
+    * \brief Номер публикации.
+    *
+    * Растет на \a 1 после каждой функции, изменившей игру.
+    */
+   uint64_t version;
+   GameStatus status;          ///< #Game::status
+   uint32_t score;             ///< #Game::score
+   GameCoordinate width;       ///< #Game::width
+   GameCoordinate height;      ///< #Game::height
+   GameFieldMode fieldMode;    ///< #Game::fieldMode
+   /*!
+    * \brief #ActiveTetromino::size или \a 0, если активное тетрамино не
+    * показывается.
+    */
+   int8_t activeTetrominoSize;
+   GameCoordinate activeTetrominoX; ///< #ActiveTetromino::x
+   GameCoordinate activeTetrominoY; ///< #ActiveTetromino::y
+   /*!
+    * \brief Копия #ActiveTetromino::pixels.
+    */
+   TetrominoPixel activeTetrominoPixels[tetrominoArrayMaxSize];
+   /*!
+    * \brief #NextTetromino::size или \a 0, если очередь следующих
+    * тетрамино пуста.
+    */
+   int8_t nextTetrominoSize;
+   /*!
+    * \brief Копия #NextTetromino::pixels.
+    */
+   TetrominoPixel nextTetrominoPixels[tetrominoArrayMaxSize];
+} GameView;
+
+/*!
+ * \brief Публикатор копий игры для других потоков.
+ *
+ * Внутреннее устройство скрыто.
+ *
+ * \see #attachGameView
+ */
+typedef struct tagGameViewPublisher GameViewPublisher;
+#endif
+
+#ifdef TETRIS_ENGINE_STATS_TIMERS
+#ifndef TETRIS_ENGINE_STATS
+#define TETRIS_ENGINE_STATS
+#endif
+#endif
+
+#ifdef TETRIS_ENGINE_STATS
+/*!
+ * \brief Счетчики горячих путей игры.
+ *
+ * Существует только при сборке с макросом TETRIS_ENGINE_STATS (например,
+ * \a -DTETRIS_ENGINE_STATS). Без него счетчики и их обновление не
+ * компилируются вовсе. Макрос TETRIS_ENGINE_STATS_TIMERS дополнительно
+ * включает таймеры (и сам включает TETRIS_ENGINE_STATS).
+ *
+ * \warning Макросы должны быть одинаковыми при сборке движка и всех
+ * единиц трансляции, использующих engine.h, так как от них зависит
+ * размер #Game.
+ *
+ * \see #getGameStats
+ * \see #resetGameStats
+ */
+typedef struct tagGameStats {
+   /*!
+    * \brief Количество вызовов функций ввода.
+    *
+    * Индекс равен #GameInput функции. Вызовы через #applyInput тоже
+    * учитываются.
+    */
+   uint64_t inputCalls[gameInputCount];
+   /*!
+    * \brief Количество вызовов функций ввода, вернувших ненулевое значение.
+    *
+    * Для перемещений и поворотов это неудачные попытки, для #tick,
+    * #softDrop и #hardDrop - вызовы, после которых тетрамино не может
+    * двигаться вниз.
+    */
+   uint64_t inputFailures[gameInputCount];
+   uint64_t fieldPixelReads;        ///< Вызовы #getGameFieldPixel.
+   uint64_t collisionChecks;        ///< Проверки коллизий маски тетрамино.
+   uint64_t collisionRowProbes;     ///< Строки битовой доски, прочитанные при проверках коллизий.
+   uint64_t skylineTicks;           ///< Вызовы #tick, сдвинувшие тетрамино без проверки коллизий.
+   uint64_t shapeMisses;            ///< Активные тетрамино, форму которых пришлось вычислить.
+   uint64_t lockedTetrominoes;      ///< Зафиксированные тетрамино.
+   uint64_t cleanLinesCalls;        ///< Поиски заполненных строк.
+   uint64_t scannedRows;            ///< Строки, проверенные на заполненность.
+   uint64_t clearedRows;            ///< Очищенные строки.
+   uint64_t movedRows;              ///< Строки, сдвинутые вниз после очистки.
+   uint64_t generatorCalls;         ///< Вызовы #Game::getNextTetromino.
+   uint64_t generatedTetrominoes;   ///< Тетрамино, добавленные в очередь любым генератором.
+   uint64_t placementSearches;      ///< Вызовы #findPlacements.
+   uint64_t placementStates;        ///< Положения, посещенные #findPlacements.
+#ifdef TETRIS_ENGINE_STATS_TIMERS
+   /*!
+    * \brief Суммарное время #applyInput в наносекундах по видам ввода.
+    *
+    * Прямые вызовы функций ввода не замеряются.
+    */
+   uint64_t inputNanoseconds[gameInputCount];
+   uint64_t cleanLinesNanoseconds;  ///< Суммарное время очистки строк в наносекундах.
+   uint64_t placementNanoseconds;   ///< Суммарное время #findPlacements в наносекундах.
+#endif
+} GameStats;
+#endif
+
 /*!
  * \brief Сама игра.
  */
@@ -229,15 +946,17 @@ typedef struct tagGame {
    /*!
     * \brief Ширина игрового стакана в пикселах.
     * 
-    * Больше или равна #tetrominoMaxSize.
+    * Больше или равна #tetrominoMaxSize и не больше #gameCoordinateMax -
+    * #tetrominoMaxSize.
     */
-   const int8_t width;
+   const GameCoordinate width;
    /*!
     * \brief Высота игрового стакана в пикселах.
     * 
-    * Больше или равна #tetrominoMaxSize.
+    * Больше или равна #tetrominoMaxSize и не больше #gameCoordinateMax -
+    * #tetrominoMaxSize.
     */
-   const int8_t height;
+   const GameCoordinate height;
    /*!
     * \brief Количество очков.
     * 
@@ -260,16 +979,95 @@ typedef struct tagGame {
     */
    TetrominoPixelArray const gameField;
    /*!
-    * \brief Активное тетрамино.
+    * \brief Режим хранения активного тетрамино в #gameField.
     * 
-    * \warning Если значение #status установлено в #initGameStatus, активное
-    * тетрамино аллоцировано, но не инициализировано.
+    * По умолчанию #compositeGameFieldMode. Меняется функцией
+    * #setGameFieldMode.
     */
-   ActiveTetromino* activeTetromino;
+   const GameFieldMode fieldMode;
    /*!
-    * \brief Следующего тетрамино.
-    */
+    * \brief Битовая доска занятости игрового стакана.
+    *
+    * Содержит только зафиксированные пикселы (без активного тетрамино) и
+    * используется для проверки коллизий. Каждая строка занимает
+    * #occupancyRowWords машинных слов. Бит с номером \a x + #occupancyPadding
+    * строки \a y + #occupancyPadding соответствует пикселу \a x:y игрового
+    * стакана. Биты слева и справа от стакана (стены) всегда установлены.
+    * Строки снизу от стакана (дно) заполнены полностью, строки сверху от
+    * стакана содержат только стены.
+    *
+    * \note Длина одномерного массива равна (#height + 2 * #occupancyPadding)
+    * * #occupancyRowWords.
+    */
+   uint64_t* const occupancy;
+   /*!
+    * \brief Количество машинных слов в одной строке #occupancy.
+    */
+   const GameCoordinate occupancyRowWords;
+   /*!
+    * \brief Высота каждого столбца игрового стакана.
+    *
+    * Элемент \a x равен y-координате над самым верхним зафиксированным
+    * пикселом столбца \a x или \a 0, если столбец пуст. Активное тетрамино
+    * не учитывается.
+    *
+    * \note Длина одномерного массива равна #width.
+    */
+   GameCoordinate* const columnHeights;
+   /*!
+    * \brief Количество зафиксированных пикселов в каждой строке игрового
+    * стакана.
+    *
+    * Строка \a y заполнена, если элемент \a y равен #width.
+    *
+    * \note Длина одномерного массива равна #height.
+    */
+   GameCoordinate* const rowFillCounts;
+   /*!
+    * \brief Признаки зафиксированных пикселов.
+    *
+    * Обновляются при фиксации тетрамино и очистке строк за время,
+    * пропорциональное ширине тетрамино (очистка строк - ширине стакана).
+    */
+   BoardFeatures boardFeatures;
+   /*!
+    * \brief Хеши строк игрового стакана.
+    *
+    * Элемент \a y равен XOR ключей зафиксированных пикселов строки \a y.
+    * Ключ пиксела зависит только от его x-координаты и цвета, поэтому при
+    * очистке строк хеш переносится вместе со строкой.
+    *
+    * \note Длина одномерного массива равна #height.
+    */
+   uint64_t* const rowHashes;
+   /*!
+    * \brief Хеш зафиксированных пикселов.
+    *
+    * XOR хешей непустых строк (#rowHashes), перемешанных с их
+    * y-координатами. Обновляется при фиксации тетрамино и очистке строк.
+    *
+    * \see #getGameHash
+    */
+   uint64_t boardHash;
+   /*!
+    * \brief Активное тетрамино.
+    * 
+    * \warning Если значение #status установлено в #initGameStatus, активное
+    * тетрамино аллоцировано, но не инициализировано.
+    */
+   ActiveTetromino* activeTetromino;
+   /*!
+    * \brief Следующего тетрамино.
+    */
    NextTetromino* nextTetromino;
+   /*!
+    * \brief Очередь следующих тетрамино.
+    */
+   TetrominoQueue tetrominoQueue;
+   /*!
+    * \brief Генератор следующих тетрамино.
+    */
+   TetrominoGenerator tetrominoGenerator;
    /*!
     * \brief Функция, генерирующая следующее тетрамино.
     */
@@ -279,13 +1077,203 @@ typedef struct tagGame {
     * заполнение строк.
     */
    GetScoreAddendFunction* const getScoreAddend;
+   /*!
+    * \brief Изменения, накопленные с прошлого вызова #getDirtyRegion.
+    *
+    * #DirtyRegion::oldActiveTetromino хранит прямоугольник активного
+    * тетрамино на момент прошлого вызова, #DirtyRegion::rows - только
+    * строки, измененные фиксацией и очисткой. #DirtyRegion::rows лежит в
+    * памяти игры.
+    */
+   DirtyRegion dirtyRegion;
+   /*!
+    * \brief Формы тетрамино, которые уже были активными.
+    *
+    * Не входит в снимок игры и не копируется #cloneGame: #restoreGame и
+    * #cloneGame добавляют в таблицу форму активного тетрамино.
+    */
+   TetrominoShapeTable shapeTable;
+   /*!
+    * \brief События, еще не забранные #drainGameEvents.
+    *
+    * Не входят в снимок игры и не копируются #cloneGame.
+    */
+   GameEventQueue eventQueue;
+#ifdef TETRIS_ENGINE_GAME_VIEW
+   /*!
+    * \brief Публикатор копий игры или \a NULL.
+    *
+    * Не входит в снимок игры и не копируется #cloneGame.
+    *
+    * \see #attachGameView
+    */
+   GameViewPublisher* viewPublisher;
+#endif
+#ifdef TETRIS_ENGINE_STATS
+   /*!
+    * \brief Счетчики горячих путей.
+    *
+    * Не входят в снимок игры и не копируются #cloneGame.
+    */
+   GameStats stats;
+#endif
 } Game;
 
+/*!
+ * \brief Положение, в котором активное тетрамино может быть зафиксировано.
+ *
+ * \see #findPlacements
+ */
+typedef struct tagPlacement {
+   GameCoordinate x;      ///< #ActiveTetromino::x
+   GameCoordinate y;      ///< #ActiveTetromino::y
+   int8_t orientation;    ///< #ActiveTetromino::orientation
+} Placement;
+
+/*!
+ * \brief Версия формата упакованного состояния игры (#packGameState).
+ */
+#define packedGameStateVersion 1
+
+/*!
+ * \brief Флаги упаковки состояния игры.
+ *
+ * \see #packGameState
+ */
+typedef enum tagPackedGameStateFlag {
+   /*!
+    * \brief Записать цвета зафиксированных пикселов. Без него после
+    * распаковки все зафиксированные пикселы равны \a 1.
+    */
+   colorsPackedGameStateFlag = 1,
+} PackedGameStateFlag;
+
+/*!
+ * \brief Растущий буфер байтов.
+ */
+typedef struct tagGameLogStream {
+   uint8_t* data;   ///< Байты. Может быть \a NULL, если буфер пуст
+   size_t size;     ///< Количество записанных байтов.
+   size_t capacity; ///< Размер #data.
+} GameLogStream;
+
+/*!
+ * \brief Запись игры в журнал.
+ *
+ * Журнал состоит из трех потоков:
+ *   - события: каждый ввод, кроме #tickInput и #noneInput, записывается
+ * одним числом переменной длины (varint) \a ticks * 8 + \a input, где
+ * \a ticks - количество тиков после предыдущего события. Поэтому тики не
+ * занимают места, а ввод между тиками обычно занимает один байт;
+ *   - тетрамино: для #functionTetrominoGenerator и
+ * #sequenceTetrominoGenerator каждое тетрамино, добавленное в очередь.
+ * Встроенным случайным генераторам достаточно начального состояния;
+ *   - контрольные суммы состояния игры после каждых #checksumInterval тиков.
+ *
+ * \see #startRecordedGame
+ */
+typedef struct tagGameRecorder {
+   Game* game;                          ///< Записываемая игра.
+   TetrominoGenerator initialGenerator; ///< Генератор на момент начала игры.
+   uint32_t checksumInterval;           ///< Тиков между контрольными суммами. \a 0 - не считать
+   uint32_t ticks;                      ///< Количество записанных тиков.
+   uint32_t pendingTicks;               ///< Тиков после последнего события.
+   uint32_t loggedTetrominoes;          ///< Количество записанных тетрамино.
+   unsigned outOfMemory;                ///< Не \a 0, если буфер не удалось увеличить.
+   GameLogStream events;                ///< Поток событий.
+   GameLogStream tetrominoes;           ///< Поток тетрамино.
+   GameLogStream checksums;             ///< Поток контрольных сумм.
+} GameRecorder;
+
+/*!
+ * \brief Запись архива упакованных состояний игр.
+ *
+ * Архив состоит из заголовка ("TSTA", версия, флаги #PackedGameStateFlag,
+ * ширина и высота стакана), упакованных состояний (#packGameState) подряд,
+ * индекса - смещений всех состояний от начала архива и смещения самого
+ * индекса (по 8 байтов) - и концевика (смещение индекса, 8 байтов, и
+ * количество состояний, 4 байта). Числа записаны от младшего байта к
+ * старшему.
+ *
+ * Индекс записывается в конце, поэтому байты архива можно сбрасывать в файл
+ * по мере записи (#flushGameStateArchive), не держа в памяти все состояния.
+ *
+ * \see #startGameStateArchive
+ */
+typedef struct tagGameStateArchiveWriter {
+   GameCoordinate width;  ///< Ширина стакана.
+   GameCoordinate height; ///< Высота стакана.
+   unsigned flags;        ///< Флаги #PackedGameStateFlag.
+   uint32_t count;        ///< Количество записанных состояний.
+   uint64_t position;     ///< Смещение конца #bytes от начала архива.
+   unsigned outOfMemory;  ///< Не \a 0, если буфер не удалось увеличить.
+   GameLogStream bytes;   ///< Еще не сброшенные байты архива.
+   GameLogStream offsets; ///< Индекс.
+} GameStateArchiveWriter;
+
+/*!
+ * \brief Архив упакованных состояний игр, открытый для чтения.
+ *
+ * Ссылается на байты архива и ничего не копирует, поэтому архив можно
+ * читать прямо из отображенного в память файла.
+ *
+ * \see #openGameStateArchive
+ */
+typedef struct tagGameStateArchive {
+   const uint8_t* data;   ///< Байты архива.
+   const uint8_t* index;  ///< Индекс.
+   GameCoordinate width;  ///< Ширина стакана.
+   GameCoordinate height; ///< Высота стакана.
+   unsigned flags;        ///< Флаги #PackedGameStateFlag.
+   uint32_t count;        ///< Количество состояний.
+} GameStateArchive;
+
+/*!
+ * \brief Пакет из нескольких игр с одинаковыми параметрами.
+ *
+ * Все игры пакета и все их массивы хранятся в одном блоке памяти. Массивы
+ * одного вида (игровые стаканы, битовые доски, активные тетрамино и т.д.)
+ * всех игр лежат подряд друг за другом.
+ */
+typedef struct tagGameBatch {
+   /*!
+    * \brief Количество игр.
+    */
+   const unsigned count;
+   /*!
+    * \brief Массив игр.
+    *
+    * \note Длина массива равна #count. Каждая игра может использоваться
+    * функциями tetris-engine как обычная игра, но не может быть передана в
+    * #freeGame.
+    */
+   Game* const games;
+   /*!
+    * \brief Копии #Game::status всех игр.
+    *
+    * Обновляются функциями #startGameBatch и #stepGameBatch.
+    *
+    * \note Длина массива равна #count.
+    */
+   GameStatus* const statuses;
+   /*!
+    * \brief Копии #Game::score всех игр.
+    *
+    * Обновляются функцией #stepGameBatch.
+    *
+    * \note Длина массива равна #count.
+    */
+   uint32_t* const scores;
+} GameBatch;
+
 /*!
  * \brief Инициализирует игру.
  * 
  * В #Game::status записывает #initGameStatus. 
  * 
+ * Игра со всеми массивами размещается в одном блоке памяти размером
+ * #gameRequiredBytes.
+ * 
  * \warning Функция аллоцирует массивы для следующего и активного тетрамино, но
  * не инициализирует их. Для полной инициализации требуется вызвать функцию
  * #startGame.
@@ -307,7 +1295,51 @@ typedef struct tagGame {
  * \see #startGame
  * \see #Game::maxScore
  */
-Game* initGame(int8_t width, int8_t height, int32_t maxScore,
+TETRIS_ENGINE_API Game* initGame(GameCoordinate width, GameCoordinate height, int32_t maxScore,
+      GetNextTetrominoFunction* const getNextTetrominoFunction, 
+      GetScoreAddendFunction* const getScoreAddendFunction);
+
+/*!
+ * \brief Возвращает размер блока памяти, в котором помещается игра со всеми
+ * массивами.
+ * 
+ * \param[in] width ширина игрового стакана
+ * \param[in] height высота игрового стакана
+ * 
+ * \return размер блока в байтах. Кратен размеру \a uint64_t
+ * 
+ * \see #initGameInPlace
+ */
+TETRIS_ENGINE_API size_t gameRequiredBytes(GameCoordinate width, GameCoordinate height);
+
+/*!
+ * \brief Инициализирует игру в памяти, предоставленной пользователем.
+ * 
+ * Делает то же, что и #initGame, но не выделяет память. Игра занимает
+ * начало блока, поэтому возвращаемый указатель равен \a memory.
+ * 
+ * \warning Игру, созданную этой функцией, нельзя передавать в #freeGame.
+ * Памятью \a memory управляет пользователь.
+ * 
+ * \param[out] memory блок памяти размером не меньше
+ * #gameRequiredBytes(\a width, \a height), выровненный как \a uint64_t
+ * \param[in] width ширина игрового стакана. Должна быть больше или равна 
+ * #tetrominoMaxSize
+ * \param[in] height высота игрового стакана. Должна быть больше или равна 
+ * #tetrominoMaxSize
+ * \param[in] maxScore максимально возможное количество очков
+ * \param[in] getNextTetrominoFunction функция, генерирующая следующее
+ * тетрамино
+ * \param[in] getScoreAddendFunction функция, вычисляющая количество очков,
+ * которое игрок заработал за заполнение строк
+ * 
+ * \return
+ *          - 1) \a NULL если \a memory равен \a NULL;
+ *          - 2) указатель на структуру.
+ * 
+ * \see #startGame
+ */
+TETRIS_ENGINE_API Game* initGameInPlace(void* memory, GameCoordinate width, GameCoordinate height, int32_t maxScore,
       GetNextTetrominoFunction* const getNextTetrominoFunction, 
       GetScoreAddendFunction* const getScoreAddendFunction);
 
@@ -317,7 +1349,7 @@ Game* initGame(int8_t width, int8_t height, int32_t maxScore,
  * \param[in,out] game игра, где в #Game::status установлено значение
  * #initGameStatus
  */
-void startGame(Game* game);
+TETRIS_ENGINE_API void startGame(Game* game);
 
 /*!
  * \brief Возвращает значение пиксела из игрового стакана.
@@ -328,13 +1360,181 @@ void startGame(Game* game);
  * - если пиксел находится в любом другом месте во вне игрового стакана, то
  * вернет \a 1.
  * 
+ * \note В режиме #lockedGameFieldMode активное тетрамино не учитывается.
+ * 
  * \param[in] game игра
  * \param[in] x x-координата пиксела
  * \param[in] y y-координата пиксела
  * 
  * \return значение заданного пиксела
  */
-TetrominoPixel getGameFieldPixel(Game* game, int8_t x, int8_t y);
+TETRIS_ENGINE_API TetrominoPixel getGameFieldPixel(Game* game, GameCoordinate x, GameCoordinate y);
+
+/*!
+ * \brief Меняет режим хранения активного тетрамино в игровом стакане.
+ * 
+ * Если активное тетрамино есть в игре, то при переходе в
+ * #lockedGameFieldMode оно стирается из #Game::gameField, а при переходе в
+ * #compositeGameFieldMode рисуется в нем.
+ * 
+ * \param[in,out] game игра
+ * \param[in] mode режим
+ */
+TETRIS_ENGINE_API void setGameFieldMode(Game* game, GameFieldMode mode);
+
+/*!
+ * \brief Записывает игровой стакан вместе с активным тетрамино в массив.
+ * 
+ * Результат такой же, как содержимое #Game::gameField в режиме
+ * #compositeGameFieldMode, независимо от текущего режима.
+ * 
+ * \param[in] game игра
+ * \param[out] out массив длиной #Game::width * #Game::height
+ */
+TETRIS_ENGINE_API void renderField(const Game* game, TetrominoPixel* out);
+
+/*!
+ * \brief Возвращает изменения игры с прошлого вызова и начинает
+ * накапливать их заново.
+ * 
+ * Позволяет перерисовывать или передавать по сети только измененные
+ * строки. Перемещения и повороты активного тетрамино сами строки не
+ * отмечают: строки его старого и нового прямоугольников добавляются при
+ * вызове. Фиксация и очистка строк, #restoreGame и #cloneGame отмечают
+ * измененные строки сразу.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[out] region изменения
+ * \param[out] rows массив длиной #dirtyRowWords(#Game::height) для маски
+ * измененных строк. Становится #DirtyRegion::rows изменений
+ */
+TETRIS_ENGINE_API void getDirtyRegion(Game* game, DirtyRegion* region, uint64_t* rows);
+
+/*!
+ * \brief Забирает накопленные события игры.
+ *
+ * События записываются в порядке, в котором они произошли, и удаляются из
+ * #Game::eventQueue. Фиксация тетрамино дает #lockGameEvent, затем, если
+ * строки заполнены, #lineClearGameEvent, затем #spawnGameEvent следующего
+ * тетрамино или #gameOverGameEvent.
+ *
+ * \param[in,out] game указатель на структуру
+ * \param[out] events массив для событий
+ * \param[in] capacity длина массива \a events
+ *
+ * \return количество записанных событий. Если оно равно \a capacity, в
+ * очереди могли остаться события
+ */
+TETRIS_ENGINE_API unsigned drainGameEvents(Game* game, GameEvent* events, unsigned capacity);
+
+#ifdef TETRIS_ENGINE_GAME_VIEW
+/*!
+ * \brief Начинает публиковать копии игры для других потоков.
+ *
+ * После каждой функции движка, изменившей игру, текущее состояние игры
+ * (игровой стакан, активное и следующее тетрамино, очки и состояние)
+ * копируется в публикатор. Любое количество потоков может одновременно с
+ * этим читать последнюю копию функцией #readGameView без блокировок: поток
+ * игры никогда их не ждет.
+ *
+ * Сразу публикует текущее состояние игры. Если публикатор уже есть,
+ * возвращает его.
+ *
+ * \warning #initGameInPlace для игры с публикатором теряет публикатор.
+ *
+ * \param[in,out] game указатель на структуру
+ *
+ * \return
+ *          - 1) \a NULL если не хватило памяти
+ *          - 2) указатель на публикатор
+ */
+TETRIS_ENGINE_API GameViewPublisher* attachGameView(Game* game);
+
+/*!
+ * \brief Копирует последнее опубликованное состояние игры.
+ *
+ * Можно вызывать из любого потока одновременно с функциями движка. Если
+ * игра за время копирования успела опубликоваться дважды, копирование
+ * повторяется.
+ *
+ * В режиме #lockedGameFieldMode активное тетрамино дорисовывается в
+ * \a field, поэтому \a field всегда совпадает с результатом #renderField.
+ *
+ * \param[in] publisher публикатор
+ * \param[out] view копия игры
+ * \param[out] field массив длиной #Game::width * #Game::height для копии
+ * игрового стакана или \a NULL
+ */
+TETRIS_ENGINE_API void readGameView(const GameViewPublisher* publisher, GameView* view, TetrominoPixel* field);
+
+/*!
+ * \brief Возвращает номер последней публикации (#GameView::version).
+ *
+ * Позволяет читателю не копировать игру, если она не изменилась.
+ *
+ * \param[in] publisher публикатор
+ *
+ * \return номер публикации
+ */
+TETRIS_ENGINE_API uint64_t getGameViewVersion(const GameViewPublisher* publisher);
+
+/*!
+ * \brief Прекращает публиковать копии игры и освобождает публикатор.
+ *
+ * \warning Вызывать, только когда ни один поток не читает публикатор.
+ *
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void detachGameView(Game* game);
+#endif
+
+/*!
+ * \brief Выбирает генератор следующих тетрамино.
+ * 
+ * Встроенные генераторы (#bagTetrominoGenerator, #uniformTetrominoGenerator)
+ * создают стандартные тетрамино (#TetrominoKind) без вызова
+ * #Game::getNextTetromino. Последовательность тетрамино полностью
+ * определяется \a seed.
+ * 
+ * Очередь следующих тетрамино очищается. Если игра уже идет, то она сразу
+ * заполняется новым генератором.
+ * 
+ * \param[in,out] game игра
+ * \param[in] type генератор. Для #sequenceTetrominoGenerator используйте
+ * #setTetrominoSequence
+ * \param[in] seed начальное состояние генератора случайных чисел
+ */
+TETRIS_ENGINE_API void setTetrominoGenerator(Game* game, TetrominoGeneratorType type, uint64_t seed);
+
+/*!
+ * \brief Выбирает генератор, повторяющий заданную последовательность
+ * тетрамино по кругу.
+ * 
+ * Очередь следующих тетрамино очищается так же, как в
+ * #setTetrominoGenerator.
+ * 
+ * \param[in,out] game игра
+ * \param[in] kinds массив видов (#TetrominoKind). Должен существовать, пока
+ * используется генератор
+ * \param[in] length длина массива \a kinds. Больше \a 0
+ */
+TETRIS_ENGINE_API void setTetrominoSequence(Game* game, const uint8_t* kinds, unsigned length);
+
+/*!
+ * \brief Возвращает одно из следующих тетрамино.
+ * 
+ * \param[in] game игра, где в #Game::status установлено значение, отличное от
+ * #initGameStatus
+ * \param[in] index номер тетрамино в очереди. \a 0 соответствует
+ * #Game::nextTetromino
+ * \param[out] size #NextTetromino::size тетрамино. Может быть \a NULL
+ * 
+ * \return
+ *          - 1) \a NULL если \a index больше или равен
+ * #tetrominoPreviewLength;
+ *          - 2) пикселы тетрамино (#tetrominoArrayMaxSize пикселов).
+ */
+TETRIS_ENGINE_API const TetrominoPixel* getPreviewTetromino(const Game* game, unsigned index, int8_t* size);
 
 /*!
  * \brief Если это возможно, поворачивает активное тетрамино по часовой
@@ -347,7 +1547,7 @@ TetrominoPixel getGameFieldPixel(Game* game, int8_t x, int8_t y);
  *          - 1) \a 0 если тетрамино удалось повернуть по часовой стрелке
  *          - 2) \a 1 если тетрамино не удалось повернуть по часовой стрелке
  */
-unsigned rotateClockwise(Game* game);
+TETRIS_ENGINE_API unsigned rotateClockwise(Game* game);
 
 /*!
  * \brief Если это возможно, поворачивает активное тетрамино против часовой
@@ -361,7 +1561,7 @@ unsigned rotateClockwise(Game* game);
  *          - 2) \a 1 если тетрамино не удалось повернуть против часовой
  * стрелке
  */
-unsigned rotateAgainstClockwise(Game* game);
+TETRIS_ENGINE_API unsigned rotateAgainstClockwise(Game* game);
 
 /*!
  * \brief Если это возможно, двигает активное тетрамино влево.
@@ -373,7 +1573,7 @@ unsigned rotateAgainstClockwise(Game* game);
  *          - 1) \a 0 если активное тетрамино удалось подвинуть влево
  *          - 2) \a 1 если активное тетрамино не удалось подвинуть влево
  */
-unsigned moveLeft(Game* game);
+TETRIS_ENGINE_API unsigned moveLeft(Game* game);
 
 /*!
  * \brief Если это возможно, двигает активное тетрамино вправо.
@@ -385,7 +1585,7 @@ unsigned moveLeft(Game* game);
  *          - 1) \a 0 если активное тетрамино удалось подвинуть вправо
  *          - 2) \a 1 если активное тетрамино не удалось подвинуть вправо
  */
-unsigned moveRight(Game* game);
+TETRIS_ENGINE_API unsigned moveRight(Game* game);
 
 /*!
  * \brief Имплементриует тик. 
@@ -393,6 +1593,9 @@ unsigned moveRight(Game* game);
  * Если достигнут максимум очков или игрок проиграл выставляет соответствующие 
  * статусы в #Game::status.
  * 
+ * Пока нижняя строка активного тетрамино выше самого высокого столбца
+ * (#BoardFeatures::maxHeight), тетрамино сдвигается без проверки коллизий.
+ * 
  * \param[in,out] game игра, где в #Game::status установлено значение
  * #playGameStatus
  * 
@@ -402,13 +1605,547 @@ unsigned moveRight(Game* game);
  *          - 3) \a 2 если достигнут максимум очков
  *          - 4) \a 3 если игрок проиграл
  */
-unsigned tick(Game* game);
+TETRIS_ENGINE_API unsigned tick(Game* game);
+
+/*!
+ * \brief Мгновенно роняет активное тетрамино вниз и фиксирует его.
+ * 
+ * Результат такой же, как у вызова #tick до тех пор, пока он не вернет
+ * ненулевое значение, но строка приземления вычисляется сразу.
+ * 
+ * \param[in,out] game игра, где в #Game::status установлено значение
+ * #playGameStatus
+ * \param[out] droppedRows количество строк, которое пролетело тетрамино. Может
+ * быть \a NULL
+ * 
+ * \return
+ *          - 1) \a 1 если тетрамино зафиксировано и игра продолжается
+ *          - 2) \a 2 если достигнут максимум очков
+ *          - 3) \a 3 если игрок проиграл
+ */
+TETRIS_ENGINE_API unsigned hardDrop(Game* game, GameCoordinate* droppedRows);
 
 /*!
- * \brief Освобождает игру.
+ * \brief Если это возможно, двигает активное тетрамино вниз на \a rows
+ * строк.
+ * 
+ * Если тетрамино может подвинуться только на меньшее количество строк, то
+ * двигает его до приземления. Тетрамино не фиксируется.
+ * 
+ * \param[in,out] game игра, где в #Game::status установлено значение
+ * #playGameStatus
+ * \param[in] rows количество строк
+ * \param[out] droppedRows количество строк, на которое тетрамино подвинулось.
+ * Может быть \a NULL
+ * 
+ * \return
+ *          - 1) \a 0 если активное тетрамино удалось подвинуть на \a rows
+ * строк
+ *          - 2) \a 1 если активное тетрамино приземлилось раньше
+ */
+TETRIS_ENGINE_API unsigned softDrop(Game* game, GameCoordinate rows, GameCoordinate* droppedRows);
+
+/*!
+ * \brief Находит все положения, в которых может быть зафиксировано активное
+ * тетрамино.
+ * 
+ * Выполняет поиск в ширину по состояниям (x, y, поворот), достижимым из
+ * текущего состояния активного тетрамино с помощью #moveLeft, #moveRight,
+ * #rotateClockwise, #rotateAgainstClockwise и падения на одну строку. Для
+ * проверки переходов используются те же правила, что и в этих функциях.
+ * 
+ * Положения записываются в порядке поиска, поэтому положения, до которых
+ * можно добраться за меньшее количество действий, идут раньше. Положения с
+ * одинаковыми занятыми пикселами (например, разные повороты O тетрамино)
+ * записываются один раз. Положения, фиксация в которых приводит к проигрышу,
+ * не записываются.
+ * 
+ * Выделяет рабочую память на время вызова. Чтобы не выделять ее при каждом
+ * вызове, используйте #findPlacementsWithScratch.
+ * 
+ * \param[in] game игра, где в #Game::status установлено значение
+ * #playGameStatus
+ * \param[out] placements массив для найденных положений
+ * \param[in] capacity длина массива \a placements
+ * 
+ * \return
+ *          - 1) \a -1 в случае ошибки (нехватка памяти);
+ *          - 2) количество найденных положений. Если оно больше \a capacity,
+ * то записаны только первые \a capacity положений.
+ */
+TETRIS_ENGINE_API int findPlacements(Game* game, Placement* placements, unsigned capacity);
+
+/*!
+ * \brief Возвращает размер рабочей памяти #findPlacementsWithScratch.
+ * 
+ * \param[in] width ширина игрового стакана
+ * \param[in] height высота игрового стакана
+ * 
+ * \return размер в байтах
+ */
+TETRIS_ENGINE_API size_t placementScratchBytes(GameCoordinate width, GameCoordinate height);
+
+/*!
+ * \brief То же, что и #findPlacements, но в рабочей памяти вызывающего.
+ * 
+ * Память не выделяется, поэтому рабочую память можно переиспользовать между
+ * вызовами, например, в каждом узле поиска.
+ * 
+ * \param[in] game игра, где в #Game::status установлено значение
+ * #playGameStatus
+ * \param[out] scratch рабочая память размером #placementScratchBytes,
+ * выровненная как \a uint32_t
+ * \param[out] placements массив для найденных положений
+ * \param[in] capacity длина массива \a placements
+ * 
+ * \return
+ *          - 1) \a -1 если стакан слишком большой для поиска;
+ *          - 2) количество найденных положений. Если оно больше \a capacity,
+ * то записаны только первые \a capacity положений.
+ */
+TETRIS_ENGINE_API int findPlacementsWithScratch(Game* game, void* scratch, Placement* placements, unsigned capacity);
+
+/*!
+ * \brief Переносит активное тетрамино в заданное положение и фиксирует его.
+ * 
+ * Результат такой же, как у #hardDrop после перемещения тетрамино в
+ * \a placement.
+ * 
+ * \warning Положение не проверяется. Оно должно быть получено от
+ * #findPlacements для текущего активного тетрамино.
+ * 
+ * \param[in,out] game игра, где в #Game::status установлено значение
+ * #playGameStatus
+ * \param[in] placement положение
+ * 
+ * \return
+ *          - 1) \a 1 если тетрамино зафиксировано и игра продолжается
+ *          - 2) \a 2 если достигнут максимум очков
+ *          - 3) \a 3 если игрок проиграл
+ */
+TETRIS_ENGINE_API unsigned placeActiveTetromino(Game* game, const Placement* placement);
+
+/*!
+ * \brief Оценивает положение активного тетрамино, не меняя игру.
+ *
+ * Вычисляет #BoardFeatures, которые будут у игры после фиксации активного
+ * тетрамино в \a placement и очистки заполненных строк, по
+ * #Game::boardFeatures и столбцам и строкам, которые занимает тетрамино.
+ * Поэтому оценка стоит O(ширина тетрамино), а не O(#Game::width *
+ * #Game::height). Если положение очищает строки, высоты всех столбцов
+ * сдвигаются, и оценка стоит O(#Game::width).
+ *
+ * \param[in] game игра
+ * \param[in] placement положение, например, от #findPlacements
+ * \param[out] features признаки после фиксации
+ *
+ * \return
+ *          - 1) \a -1 если положение занято или тетрамино выходит за
+ * верх игрового стакана (игрок проиграет). \a features не меняется
+ *          - 2) количество очищенных строк
+ */
+TETRIS_ENGINE_API int evaluatePlacement(const Game* game, const Placement* placement, BoardFeatures* features);
+
+/*!
+ * \brief Применяет ввод пользователя к игре.
+ * 
+ * \param[in,out] game игра, где в #Game::status установлено значение
+ * #playGameStatus
+ * \param[in] input ввод
+ * 
+ * \return значение, которое вернула соответствующая вводу функция, или \a 0
+ * для #noneInput
+ */
+TETRIS_ENGINE_API unsigned applyInput(Game* game, GameInput input);
+
+/*!
+ * \brief Возвращает 64-битный хеш позиции для таблиц транспозиций.
+ * 
+ * Хеш Зобриста: #Game::boardHash, к которому за O(1) добавляются вид,
+ * положение и ориентация активного тетрамино и вид следующего тетрамино.
+ * Очки, статус и остальная очередь не учитываются. Хеш не зависит от
+ * #Game::fieldMode и одинаков во всех процессах, поэтому клиенты, играющие
+ * синхронно, могут сравнивать позиции по нему.
+ * 
+ * \param[in] game игра
+ * 
+ * \return хеш
+ */
+TETRIS_ENGINE_API uint64_t getGameHash(const Game* game);
+
+/*!
+ * \brief Возвращает размер снимка игры в байтах.
+ * 
+ * Размер зависит только от #Game::width и #Game::height, поэтому снимки игр
+ * с одинаковыми размерами стакана можно хранить в одном массиве с шагом,
+ * равным этому размеру. Он кратен размеру \a uint64_t.
+ * 
+ * \param[in] game игра
+ * 
+ * \return размер снимка
+ */
+TETRIS_ENGINE_API size_t gameSnapshotSize(const Game* game);
+
+/*!
+ * \brief Записывает всё изменяемое состояние игры в буфер.
+ * 
+ * Снимок не содержит указателей на память игры и занимает один непрерывный
+ * блок, поэтому его можно копировать при помощи memcpy. Память не
+ * выделяется.
+ * 
+ * \param[in] game игра
+ * \param[out] buffer буфер размером #gameSnapshotSize, выровненный как
+ * \a uint64_t
+ */
+TETRIS_ENGINE_API void snapshotGame(const Game* game, void* buffer);
+
+/*!
+ * \brief Восстанавливает состояние игры из снимка.
+ * 
+ * #Game::maxScore, #Game::fieldMode и функции #Game::getNextTetromino и
+ * #Game::getScoreAddend не меняются: игровой стакан приводится к режиму
+ * \a game. Память не выделяется.
+ * 
+ * \note Снимок хранит очередь и состояние генератора следующих тетрамино,
+ * поэтому после восстановления игра получит те же тетрамино. Для
+ * #sequenceTetrominoGenerator в снимке хранится указатель на
+ * последовательность, а не она сама.
+ * 
+ * \param[in,out] game игра
+ * \param[in] buffer снимок, записанный #snapshotGame
+ * 
+ * \return
+ *          - 1) \a 0 если состояние восстановлено
+ *          - 2) \a 1 если размеры стакана в снимке и в игре не совпадают
+ */
+TETRIS_ENGINE_API unsigned restoreGame(Game* game, const void* buffer);
+
+/*!
+ * \brief Копирует состояние одной игры в другую.
+ * 
+ * Результат такой же, как у #snapshotGame и #restoreGame, но без
+ * промежуточного буфера. #Game::fieldMode приемника
+ * не меняется.
+ * 
+ * \param[in,out] destination игра, в которую копируется состояние
+ * \param[in] source игра, состояние которой копируется
+ * 
+ * \return
+ *          - 1) \a 0 если состояние скопировано
+ *          - 2) \a 1 если размеры стаканов не совпадают
+ */
+TETRIS_ENGINE_API unsigned cloneGame(Game* destination, const Game* source);
+
+/*!
+ * \brief Запускает игру и начинает её запись.
+ * 
+ * Вызывает #startGame. Весь дальнейший ввод нужно передавать через
+ * #recordInput: функции ввода, вызванные напрямую, не записываются.
+ * 
+ * \param[out] recorder запись
+ * \param[in,out] game игра, где в #Game::status установлено значение
+ * #initGameStatus
+ * \param[in] checksumInterval количество тиков между контрольными суммами.
+ * \a 0 отключает контрольные суммы
+ */
+TETRIS_ENGINE_API void startRecordedGame(GameRecorder* recorder, Game* game, uint32_t checksumInterval);
+
+/*!
+ * \brief Применяет ввод к записываемой игре и записывает его.
+ * 
+ * Ввод не меньше #gameInputCount игнорируется и не записывается, как и в
+ * #applyInput.
+ * 
+ * \param[in,out] recorder запись
+ * \param[in] input ввод
+ * 
+ * \return
+ *          - 1) \a -1 в случае ошибки (нехватка памяти). Ввод применен, но
+ * журнал испорчен;
+ *          - 2) значение, которое вернул #applyInput.
+ */
+TETRIS_ENGINE_API int recordInput(GameRecorder* recorder, GameInput input);
+
+/*!
+ * \brief Заканчивает запись и собирает журнал в один блок памяти.
+ * 
+ * Буферы записи освобождаются. Журнал освобождается функцией free.
+ * 
+ * \param[in,out] recorder запись
+ * \param[out] size размер журнала в байтах
+ * 
+ * \return
+ *          - 1) \a NULL в случае ошибки (нехватка памяти);
+ *          - 2) журнал.
+ */
+TETRIS_ENGINE_API uint8_t* finishGameRecording(GameRecorder* recorder, size_t* size);
+
+/*!
+ * \brief Освобождает буферы записи без сборки журнала.
+ * 
+ * \param[in,out] recorder запись
+ */
+TETRIS_ENGINE_API void freeGameRecorder(GameRecorder* recorder);
+
+/*!
+ * \brief Воспроизводит журнал игры с максимальной скоростью.
+ * 
+ * Запускает игру и применяет к ней все записанные события, проверяя
+ * контрольные суммы по мере их появления. Игра должна быть создана с тем же
+ * размером стакана, #Game::maxScore и #Game::getScoreAddend, что и
+ * записанная. Режим игрового стакана (#GameFieldMode) может отличаться:
+ * контрольные суммы от него не зависят.
+ * 
+ * \param[in,out] game игра, где в #Game::status установлено значение
+ * #initGameStatus
+ * \param[in] log журнал, собранный #finishGameRecording. Должен существовать
+ * во время воспроизведения
+ * \param[in] size размер журнала в байтах
+ * \param[out] ticks количество воспроизведенных тиков (при расхождении -
+ * номер тика, на котором оно обнаружено). Может быть \a NULL
+ * 
+ * \return
+ *          - 1) \a 0 если журнал воспроизведен полностью;
+ *          - 2) \a 1 если журнал поврежден или не подходит к игре;
+ *          - 3) \a 2 если контрольная сумма не совпала.
+ */
+TETRIS_ENGINE_API unsigned replayGameLog(Game* game, const uint8_t* log, size_t size, uint32_t* ticks);
+
+/*!
+ * \brief Возвращает наибольший размер упакованного состояния игры.
+ * 
+ * \param[in] width ширина игрового стакана
+ * \param[in] height высота игрового стакана
+ * \param[in] flags флаги #PackedGameStateFlag
+ * 
+ * \return размер в байтах
+ */
+TETRIS_ENGINE_API size_t packedGameStateMaxSize(GameCoordinate width, GameCoordinate height, unsigned flags);
+
+/*!
+ * \brief Упаковывает состояние игры в буфер.
+ * 
+ * Упакованное состояние - это поток бит без указателей и выравнивания:
+ * версия формата (#packedGameStateVersion), флаги, размеры стакана,
+ * статус, очки, состояние генератора, очередь и активное тетрамино
+ * (стандартное тетрамино занимает три бита), высота стека и по биту на
+ * каждый пиксел строк стека. С #colorsPackedGameStateFlag за ними идут
+ * палитра и серии одноцветных зафиксированных пикселов. Стакан 10x20 без
+ * цветов занимает несколько десятков байтов.
+ * 
+ * Не упаковываются #Game::fieldMode, #Game::maxScore, события и
+ * последовательность #sequenceTetrominoGenerator или журнал
+ * #logTetrominoGenerator (только позиция в них). Память не выделяется.
+ * 
+ * \param[in] game игра
+ * \param[in] flags флаги #PackedGameStateFlag
+ * \param[out] buffer буфер
+ * \param[in] capacity размер буфера. #packedGameStateMaxSize всегда
+ * достаточно
+ * 
+ * \return
+ *          - 1) \a 0 если буфера не хватило;
+ *          - 2) размер упакованного состояния в байтах.
+ */
+TETRIS_ENGINE_API size_t packGameState(const Game* game, unsigned flags, uint8_t* buffer, size_t capacity);
+
+/*!
+ * \brief Распаковывает состояние игры, упакованное #packGameState.
+ * 
+ * Битовая доска, #Game::columnHeights, #Game::rowFillCounts,
+ * #Game::boardFeatures и хеши (#Game::boardHash) вычисляются по стакану. #Game::fieldMode,
+ * #Game::maxScore, функции игры и события не меняются. Память не
+ * выделяется.
+ * 
+ * \param[in,out] game игра. Для #sequenceTetrominoGenerator и
+ * #logTetrominoGenerator в ней должен быть установлен такой же генератор
+ * \param[in] buffer упакованное состояние
+ * \param[in] size размер упакованного состояния в байтах
+ * 
+ * \return
+ *          - 1) \a 0 если состояние распаковано;
+ *          - 2) \a 1 если оно испорчено или не подходит к игре. Игра не
+ * меняется.
+ */
+TETRIS_ENGINE_API unsigned unpackGameState(Game* game, const uint8_t* buffer, size_t size);
+
+/*!
+ * \brief Начинает запись архива упакованных состояний игр.
+ *
+ * \param[out] writer запись
+ * \param[in] width ширина стакана всех состояний архива
+ * \param[in] height высота стакана всех состояний архива
+ * \param[in] flags флаги #PackedGameStateFlag всех состояний архива
+ *
+ * \return
+ *          - 1) \a 0 в случае успеха;
+ *          - 2) \a 1 в случае ошибки (нехватка памяти).
+ */
+TETRIS_ENGINE_API unsigned startGameStateArchive(GameStateArchiveWriter* writer, GameCoordinate width,
+      GameCoordinate height, unsigned flags);
+
+/*!
+ * \brief Упаковывает состояние игры в конец архива.
+ *
+ * \param[in,out] writer запись
+ * \param[in] game игра с размером стакана архива
+ *
+ * \return
+ *          - 1) \a 0 если состояние записано;
+ *          - 2) \a 1 если размер стакана не совпадает с архивом;
+ *          - 3) \a -1 в случае ошибки (нехватка памяти). Архив испорчен.
+ */
+TETRIS_ENGINE_API int appendGameState(GameStateArchiveWriter* writer, const Game* game);
+
+/*!
+ * \brief Отдает байты архива, записанные после предыдущего сброса.
+ *
+ * Байты нужно дописать в файл архива до следующего вызова функций записи.
+ *
+ * \param[in,out] writer запись
+ * \param[out] size количество байтов
+ *
+ * \return байты. Может быть \a NULL, если \a size равен \a 0
+ */
+TETRIS_ENGINE_API const uint8_t* flushGameStateArchive(GameStateArchiveWriter* writer, size_t* size);
+
+/*!
+ * \brief Заканчивает архив индексом.
+ *
+ * Возвращает оставшиеся несброшенные байты архива вместе с индексом и
+ * концевиком. Буферы записи освобождаются. Байты освобождаются функцией
+ * free.
+ *
+ * \param[in,out] writer запись
+ * \param[out] size количество байтов
+ *
+ * \return
+ *          - 1) \a NULL в случае ошибки (нехватка памяти);
+ *          - 2) байты.
+ */
+TETRIS_ENGINE_API uint8_t* finishGameStateArchive(GameStateArchiveWriter* writer, size_t* size);
+
+/*!
+ * \brief Освобождает буферы записи архива без индекса.
+ *
+ * \param[in,out] writer запись
+ */
+TETRIS_ENGINE_API void freeGameStateArchiveWriter(GameStateArchiveWriter* writer);
+
+/*!
+ * \brief Открывает архив упакованных состояний игр для чтения.
+ *
+ * Проверяет заголовок, концевик и границы индекса. Память не выделяется.
+ *
+ * \param[out] archive архив
+ * \param[in] data байты архива, например, отображенный в память файл.
+ * Должны существовать, пока архив читается
+ * \param[in] size размер архива в байтах
+ *
+ * \return
+ *          - 1) \a 0 если архив открыт;
+ *          - 2) \a 1 если он испорчен.
+ */
+TETRIS_ENGINE_API unsigned openGameStateArchive(GameStateArchive* archive, const uint8_t* data, size_t size);
+
+/*!
+ * \brief Возвращает упакованное состояние по номеру за O(1).
+ *
+ * Состояние распаковывается #unpackGameState.
+ *
+ * \param[in] archive архив
+ * \param[in] index номер состояния
+ * \param[out] size размер упакованного состояния в байтах
+ *
+ * \return
+ *          - 1) \a NULL если номер не меньше #GameStateArchive::count или
+ * индекс испорчен;
+ *          - 2) упакованное состояние.
+ */
+TETRIS_ENGINE_API const uint8_t* getArchivedGameState(const GameStateArchive* archive, uint32_t index, size_t* size);
+
+/*!
+ * \brief Освобождает игру вместе с ее публикатором (#attachGameView).
+ * 
+ * \note Только для игр, созданных #initGame.
  * 
  * \param[out] game игра
  */
-void freeGame(Game* game);
+TETRIS_ENGINE_API void freeGame(Game* game);
+
+/*!
+ * \brief Инициализирует пакет игр.
+ * 
+ * Все игры пакета создаются как при вызове #initGame с теми же параметрами.
+ * 
+ * \param[in] count количество игр
+ * \param[in] width ширина игрового стакана. Должна быть больше или равна 
+ * #tetrominoMaxSize
+ * \param[in] height высота игрового стакана. Должна быть больше или равна 
+ * #tetrominoMaxSize
+ * \param[in] maxScore максимально возможное количество очков
+ * \param[in] getNextTetrominoFunction функция, генерирующая следующее
+ * тетрамино
+ * \param[in] getScoreAddendFunction функция, вычисляющая количество очков,
+ * которое игрок заработал за заполнение строк
+ * 
+ * \return
+ *          - 1) \a NULL в случае ошибки (нехватка памяти);
+ *          - 2) указатель на структуру.
+ */
+TETRIS_ENGINE_API GameBatch* initGameBatch(unsigned count, GameCoordinate width, GameCoordinate height, int32_t maxScore,
+      GetNextTetrominoFunction* const getNextTetrominoFunction, 
+      GetScoreAddendFunction* const getScoreAddendFunction);
+
+/*!
+ * \brief Запускает все игры пакета.
+ * 
+ * \param[in,out] batch пакет, где все игры имеют статус #initGameStatus
+ */
+TETRIS_ENGINE_API void startGameBatch(GameBatch* batch);
+
+/*!
+ * \brief Применяет к каждой игре пакета свой ввод.
+ * 
+ * Игры, статус которых не #playGameStatus, пропускаются.
+ * 
+ * \param[in,out] batch пакет
+ * \param[in] inputs массив длиной #GameBatch::count: ввод для каждой игры.
+ * Если \a NULL, то к каждой игре применяется #tickInput
+ * \param[out] results массив длиной #GameBatch::count, в который
+ * записываются значения, которые вернул #applyInput (\a 0 для пропущенных
+ * игр). Может быть \a NULL
+ * 
+ * \return количество игр, которые продолжаются
+ */
+TETRIS_ENGINE_API unsigned stepGameBatch(GameBatch* batch, const GameInput* inputs, unsigned* results);
+
+/*!
+ * \brief Освобождает пакет игр вместе с публикаторами его игр.
+ * 
+ * \param[out] batch пакет
+ */
+TETRIS_ENGINE_API void freeGameBatch(GameBatch* batch);
+
+#ifdef TETRIS_ENGINE_STATS
+/*!
+ * \brief Возвращает счетчики горячих путей игры.
+ * 
+ * Счетчики накапливаются с создания игры или последнего вызова
+ * #resetGameStats.
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return указатель на счетчики (равен &\a game->stats)
+ */
+TETRIS_ENGINE_API const GameStats* getGameStats(const Game* game);
+
+/*!
+ * \brief Обнуляет счетчики горячих путей игры.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void resetGameStats(Game* game);
+#endif
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef MIROSLAVBEL_TETRIS_ENGINE_ENGINE_FIXED_H
+#define MIROSLAVBEL_TETRIS_ENGINE_ENGINE_FIXED_H
+
+/*!
+ * \file engine_fixed.h
+ * \brief Движок в виде одного заголовка для игрового стакана фиксированного
+ * размера.
+ *
+ * Перед включением нужно определить макросы TETRIS_ENGINE_FIXED_WIDTH и
+ * TETRIS_ENGINE_FIXED_HEIGHT:
+ *
+ * \code
+ * #define TETRIS_ENGINE_FIXED_WIDTH 10
+ * #define TETRIS_ENGINE_FIXED_HEIGHT 20
+ * #include <engine_fixed.h>
+ * \endcode
+ *
+ * Ширина и высота стакана становятся константами времени компиляции, а все
+ * функции движка - \a static \a inline, поэтому компилятор может развернуть
+ * циклы по строкам и столбцам, сделать маски строк битовой доски
+ * фиксированной длины и встроить проверки коллизий в вызывающий код.
+ * Объектный файл движка линковать не нужно.
+ *
+ * API совпадает с engine.h. #initGame, #initGameInPlace и #initGameBatch
+ * возвращают \a NULL, если размер стакана отличается от заданного.
+ *
+ * \warning Макросы сборки (TETRIS_ENGINE_STATS,
+ * TETRIS_ENGINE_WIDE_COORDINATES) должны быть одинаковыми во всех единицах
+ * трансляции программы, использующих движок.
+ */
+
+#if !defined(TETRIS_ENGINE_FIXED_WIDTH) || !defined(TETRIS_ENGINE_FIXED_HEIGHT)
+#error "define TETRIS_ENGINE_FIXED_WIDTH and TETRIS_ENGINE_FIXED_HEIGHT before including engine_fixed.h"
+#endif
+
+#ifdef TETRIS_ENGINE_API
+#error "engine_fixed.h must be included before engine.h"
+#endif
+#define TETRIS_ENGINE_API static inline
+
+#include "engine.h"
+#include "../src/engine.c"
+
+#endif
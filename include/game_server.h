@@ -0,0 +1,171 @@
+#ifndef MIROSLAVBEL_TETRIS_ENGINE_GAME_SERVER_H
+#define MIROSLAVBEL_TETRIS_ENGINE_GAME_SERVER_H
+
+#include <engine.h>
+
+/*!
+ * \file game_server.h
+ * \brief Многопоточная среда выполнения для большого количества игр.
+ *
+ * Игры распределяются между фиксированным набором рабочих потоков: каждый
+ * поток владеет непрерывным диапазоном игр, и только он вызывает для них
+ * функции tetris-engine. Поэтому сам движок по-прежнему не обязан быть
+ * потокобезопасным, а блокировки не нужны.
+ *
+ * Ввод передается в игру через очередь без блокировок с одним писателем и
+ * одним читателем (#pushGameServerInput). Рабочий поток в каждом проходе по
+ * своим играм применяет весь накопленный ввод (#applyInput) и вызывает
+ * #tick, когда пришло время падения тетрамино.
+ *
+ * Зависит от потоков и атомарных операций C11 (threads.h и stdatomic.h).
+ */
+
+/*!
+ * \brief Длина очереди ввода одной игры.
+ *
+ * Степень двойки.
+ */
+#define gameInputQueueCapacity 64
+
+/*!
+ * \brief Параметры сервера игр.
+ *
+ * \see #startGameServer
+ */
+typedef struct tagGameServerConfig {
+   unsigned workerCount;  ///< Количество рабочих потоков. Больше \a 0
+   unsigned gameCount;    ///< Количество игр. Не меньше #workerCount
+   GameCoordinate width;  ///< #Game::width всех игр
+   GameCoordinate height; ///< #Game::height всех игр
+   int32_t maxScore;      ///< #Game::maxScore всех игр
+   /*!
+    * \brief #Game::getNextTetromino всех игр.
+    *
+    * \warning Вызывается из разных рабочих потоков одновременно, поэтому
+    * должна быть потокобезопасной. Используется, только если
+    * #generatorType равен #functionTetrominoGenerator.
+    */
+   GetNextTetrominoFunction* getNextTetromino;
+   /*!
+    * \brief #Game::getScoreAddend всех игр.
+    *
+    * \warning Вызывается из разных рабочих потоков одновременно.
+    */
+   GetScoreAddendFunction* getScoreAddend;
+   /*!
+    * \brief Генератор тетрамино всех игр (см. #setTetrominoGenerator).
+    *
+    * Игра с номером \a i получает зерно #seed + \a i.
+    */
+   TetrominoGeneratorType generatorType;
+   uint64_t seed;          ///< Начальное зерно генераторов.
+   /*!
+    * \brief Интервал между вызовами #tick для каждой игры в наносекундах.
+    *
+    * Если \a 0, то #tick вызывается на каждом проходе рабочего потока, то
+    * есть с максимальной скоростью.
+    */
+   uint64_t tickNanoseconds;
+   /*!
+    * \brief Перезапускать ли закончившиеся игры.
+    *
+    * Если не \a 0, то закончившаяся игра возвращается в начальное состояние
+    * с новым зерном генератора и запускается снова.
+    */
+   unsigned restartEndedGames;
+} GameServerConfig;
+
+/*!
+ * \brief Счетчики сервера игр, суммированные по всем рабочим потокам.
+ *
+ * \see #getGameServerStats
+ */
+typedef struct tagGameServerStats {
+   uint64_t appliedInputs;  ///< Ввод, примененный к играм.
+   uint64_t ticks;          ///< Вызовы #tick.
+   uint64_t restartedGames; ///< Перезапуски закончившихся игр.
+   uint64_t passes;         ///< Проходы рабочих потоков по своим играм.
+} GameServerStats;
+
+/*!
+ * \brief Сервер игр.
+ *
+ * Внутреннее устройство скрыто: с играми работают только рабочие потоки.
+ */
+typedef struct tagGameServer GameServer;
+
+/*!
+ * \brief Создает игры и запускает рабочие потоки.
+ *
+ * Все игры запускаются (#startGame) до запуска потоков.
+ *
+ * \param[in] config параметры сервера
+ *
+ * \return
+ *          - 1) \a NULL в случае ошибки (неверные параметры, нехватка памяти
+ * или не удалось создать поток);
+ *          - 2) указатель на сервер.
+ */
+GameServer* startGameServer(const GameServerConfig* config);
+
+/*!
+ * \brief Добавляет ввод в очередь игры.
+ *
+ * Не блокируется и не выделяет память.
+ *
+ * \warning Для каждой игры в один момент времени эту функцию может вызывать
+ * только один поток.
+ *
+ * \param[in,out] server сервер
+ * \param[in] gameIndex номер игры
+ * \param[in] input ввод
+ *
+ * \return
+ *          - 1) \a 0 если ввод добавлен
+ *          - 2) \a 1 если очередь игры заполнена
+ */
+unsigned pushGameServerInput(GameServer* server, unsigned gameIndex, GameInput input);
+
+/*!
+ * \brief Останавливает рабочие потоки и дожидается их завершения.
+ *
+ * Ввод, оставшийся в очередях, не применяется. Повторный вызов ничего не
+ * делает.
+ *
+ * \param[in,out] server сервер
+ */
+void stopGameServer(GameServer* server);
+
+/*!
+ * \brief Возвращает счетчики сервера.
+ *
+ * Можно вызывать и во время работы сервера: счетчики каждого потока
+ * публикуются после каждого его прохода.
+ *
+ * \param[in] server сервер
+ * \param[out] stats счетчики
+ */
+void getGameServerStats(const GameServer* server, GameServerStats* stats);
+
+/*!
+ * \brief Возвращает игру сервера.
+ *
+ * \warning Пока сервер не остановлен (#stopGameServer), игру изменяет
+ * рабочий поток, и читать ее нельзя.
+ *
+ * \param[in] server сервер
+ * \param[in] gameIndex номер игры
+ *
+ * \return игра
+ */
+const Game* getGameServerGame(const GameServer* server, unsigned gameIndex);
+
+/*!
+ * \brief Останавливает сервер, если он работает, и освобождает его вместе с
+ * играми.
+ *
+ * \param[out] server сервер. Может быть \a NULL
+ */
+void freeGameServer(GameServer* server);
+
+#endif
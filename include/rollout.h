@@ -0,0 +1,139 @@
+#ifndef MIROSLAVBEL_TETRIS_ENGINE_ROLLOUT_H
+#define MIROSLAVBEL_TETRIS_ENGINE_ROLLOUT_H
+
+#include <engine.h>
+
+/*!
+ * \file rollout.h
+ * \brief Параллельные случайные доигрывания (Monte Carlo rollouts) для
+ * поиска по дереву.
+ *
+ * #rollout доигрывает заданное количество раз из одного состояния игры на
+ * пуле потоков (#RolloutPool). Каждый поток один раз создает свою игру,
+ * массив положений и рабочую память поиска положений и переиспользует их
+ * во всех доигрываниях: доигрывание начинается с #cloneGame и память не
+ * выделяет. Каждый ход доигрывания - это выбор стратегией одного из
+ * положений #findPlacementsWithScratch и #placeActiveTetromino.
+ *
+ * У каждого доигрывания свой поток случайных чисел: из зерна и номера
+ * доигрывания получаются зерно генератора тетрамино и зерно стратегии.
+ * Поэтому результат #rollout зависит только от аргументов, а не от
+ * количества потоков и порядка их работы.
+ *
+ * Зависит от потоков и атомарных операций C11 (threads.h и stdatomic.h).
+ */
+
+/*!
+ * \brief Стратегия доигрывания: выбирает положение активного тетрамино.
+ *
+ * \warning Вызывается из разных потоков одновременно.
+ *
+ * \param[in] game игра доигрывания. Можно передавать в #evaluatePlacement
+ * \param[in] placements положения от #findPlacementsWithScratch
+ * \param[in] count количество положений. Больше \a 0
+ * \param[in,out] random состояние случайных чисел доигрывания для
+ * #nextRolloutRandom
+ * \param[in] context \a policyContext, переданный в #rollout
+ *
+ * \return номер выбранного положения из [0 .. \a count)
+ */
+typedef int RolloutPolicyFunction(const Game* game, const Placement* placements, int count, uint64_t* random,
+      void* context);
+
+/*!
+ * \brief Итоги доигрываний.
+ *
+ * Очки и строки считаются от состояния, из которого начинались
+ * доигрывания.
+ *
+ * \see #rollout
+ */
+typedef struct tagRolloutResults {
+   unsigned playouts;     ///< Количество доигрываний.
+   unsigned lostPlayouts; ///< Доигрывания, закончившиеся проигрышем.
+   double meanScore;      ///< Среднее количество набранных очков.
+   double meanLines;      ///< Среднее количество очищенных строк.
+   /*!
+    * \brief Средняя длина доигрывания (количество зафиксированных
+    * тетрамино).
+    */
+   double meanPieces;
+   uint32_t maxScore;     ///< Наибольшее количество набранных очков.
+} RolloutResults;
+
+/*!
+ * \brief Пул потоков для доигрываний.
+ *
+ * Внутреннее устройство скрыто.
+ */
+typedef struct tagRolloutPool RolloutPool;
+
+/*!
+ * \brief Создает пул и запускает его потоки.
+ *
+ * Поток, вызывающий #rollout, тоже доигрывает, поэтому пул запускает
+ * \a workerCount - 1 потоков.
+ *
+ * \param[in] workerCount количество потоков, доигрывающих одновременно.
+ * Больше \a 0
+ *
+ * \return
+ *          - 1) \a NULL в случае ошибки (неверные параметры, нехватка памяти
+ * или не удалось создать поток);
+ *          - 2) указатель на пул.
+ */
+RolloutPool* initRolloutPool(unsigned workerCount);
+
+/*!
+ * \brief Доигрывает \a count раз из состояния \a start и собирает итоги.
+ *
+ * Доигрывание заканчивается, когда игра закончилась или зафиксировано
+ * \a depth тетрамино.
+ *
+ * Очередь следующих тетрамино переходит в доигрывание из \a start, а
+ * дальше встроенный генератор (#bagTetrominoGenerator,
+ * #uniformTetrominoGenerator) продолжает со своим зерном у каждого
+ * доигрывания. #functionTetrominoGenerator вызывает
+ * #Game::getNextTetromino, которая должна быть потокобезопасной.
+ *
+ * Возвращается, когда все доигрывания закончены.
+ *
+ * \warning Пул одновременно выполняет только один вызов. \a start нельзя
+ * менять до возврата.
+ *
+ * \param[in,out] pool пул
+ * \param[in] start состояние, из которого начинаются доигрывания
+ * \param[in] policy стратегия или \a NULL для выбора положения
+ * равновероятно
+ * \param[in] policyContext аргумент \a context для \a policy
+ * \param[in] count количество доигрываний
+ * \param[in] depth наибольшее количество тетрамино в доигрывании
+ * \param[in] seed зерно. Доигрывание с номером \a i зависит только от
+ * \a seed и \a i
+ * \param[out] results итоги
+ *
+ * \return
+ *          - 1) \a 0 если все доигрывания выполнены
+ *          - 2) \a 1 в случае ошибки (нехватка памяти). \a results не
+ * меняется
+ */
+unsigned rollout(RolloutPool* pool, const Game* start, RolloutPolicyFunction* policy, void* policyContext,
+      unsigned count, unsigned depth, uint64_t seed, RolloutResults* results);
+
+/*!
+ * \brief Возвращает следующее случайное число доигрывания (SplitMix64).
+ *
+ * \param[in,out] random состояние, переданное стратегии
+ *
+ * \return случайное число
+ */
+uint64_t nextRolloutRandom(uint64_t* random);
+
+/*!
+ * \brief Останавливает потоки пула и освобождает его.
+ *
+ * \param[out] pool пул. Может быть \a NULL
+ */
+void freeRolloutPool(RolloutPool* pool);
+
+#endif
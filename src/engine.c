@@ -1,555 +1,3869 @@
 #include <string.h> // for memcpy, memmove, memset
-#include <stdlib.h> // for calloc, free, malloc,
-#include <math.h>   // for fabs, round
+#include <stdlib.h> // for abs, calloc, free, malloc
 
 #include <engine.h>
 
-Game* initGame(int8_t width, int8_t height, int32_t maxScore,
-      GetNextTetrominoFunction* const getNextTetrominoFunction, 
-      GetScoreAddendFunction* const getScoreAddendFunction) {
-   Game* game = (Game*) malloc(sizeof(Game));
-   ActiveTetromino* activeTetromino = (ActiveTetromino*) malloc(sizeof(ActiveTetromino));
-   NextTetromino* nextTetromino = (NextTetromino*) malloc(sizeof(NextTetromino));
-   TetrominoPixelArray gameField = (TetrominoPixelArray) calloc(width * height, sizeof(TetrominoPixel));
-   TetrominoPixelArray firstTetrominoArray = (TetrominoPixelArray) malloc(tetrominoMaxSize * tetrominoMaxSize * sizeof(uint8_t));
-   TetrominoPixelArray secondTetrominoArray = (TetrominoPixelArray) malloc(tetrominoMaxSize * tetrominoMaxSize * sizeof(uint8_t));
-   if (!(game && activeTetromino && nextTetromino && gameField && firstTetrominoArray && secondTetrominoArray)) {
-      free(game);
-      free(activeTetromino);
-      free(nextTetromino);
-      free(gameField);
-      free(firstTetrominoArray);
-      free(secondTetrominoArray);
-      return NULL;
-   }
-   game->status = initGameStatus;
-   *(int8_t*) &game->width = width;
-   *(int8_t*) &game->height = height;
-   game->score = 0;
-   *(uint32_t*) &game->maxScore = maxScore;
-   *(TetrominoPixelArray*) &game->gameField = gameField;
-   game->activeTetromino = activeTetromino;
-   game->activeTetromino->pixels = firstTetrominoArray;
-   game->nextTetromino = nextTetromino;
-   game->nextTetromino->pixels = secondTetrominoArray;
-   *(GetNextTetrominoFunction**) &game->getNextTetromino = getNextTetrominoFunction;
-   *(GetScoreAddendFunction**) &game->getScoreAddend = getScoreAddendFunction;
-   return game;
+#ifdef TETRIS_ENGINE_GAME_VIEW
+#include <stdatomic.h> // for atomic_load_explicit, atomic_store_explicit, atomic_thread_fence
+#endif
+
+#ifdef TETRIS_ENGINE_STATS_TIMERS
+#include <time.h> // for timespec_get
+#endif
+
+/*!
+ * \brief Возвращают #Game::width, #Game::height и #Game::occupancyRowWords.
+ * 
+ * В сборке через engine_fixed.h это константы времени компиляции, что
+ * позволяет компилятору развернуть циклы по строкам и столбцам.
+ */
+#ifdef TETRIS_ENGINE_FIXED_WIDTH
+#define getGameWidth(game) ((void) (game), (GameCoordinate) TETRIS_ENGINE_FIXED_WIDTH)
+#define getGameHeight(game) ((void) (game), (GameCoordinate) TETRIS_ENGINE_FIXED_HEIGHT)
+#define getGameOccupancyRowWords(game) \
+   ((void) (game), (GameCoordinate) ((TETRIS_ENGINE_FIXED_WIDTH + 2 * occupancyPadding + 63) / 64))
+#define isGameSizeSupported(width, height) \
+   ((width) == TETRIS_ENGINE_FIXED_WIDTH && (height) == TETRIS_ENGINE_FIXED_HEIGHT)
+#else
+#define getGameWidth(game) ((game)->width)
+#define getGameHeight(game) ((game)->height)
+#define getGameOccupancyRowWords(game) ((game)->occupancyRowWords)
+#define isGameSizeSupported(width, height) 1
+#endif
+
+/*!
+ * \brief Прибавляет \a value к счетчику \a counter из #GameStats.
+ * 
+ * Без TETRIS_ENGINE_STATS ничего не делает и не вычисляет аргументы.
+ * Счетчики диагностические, поэтому меняются и через указатель на
+ * константную игру.
+ */
+#ifdef TETRIS_ENGINE_STATS
+#define addGameStat(game, counter, value) ((void) (((Game*) (game))->stats.counter += (value)))
+#else
+#define addGameStat(game, counter, value) ((void) 0)
+#endif
+
+/*!
+ * \brief Увеличивает на единицу счетчик \a counter из #GameStats.
+ */
+#define countGameStat(game, counter) addGameStat(game, counter, 1)
+
+#ifdef TETRIS_ENGINE_STATS_TIMERS
+/*!
+ * \brief Возвращает текущее время в наносекундах для таймеров #GameStats.
+ * 
+ * \return время в наносекундах
+ */
+static inline uint64_t readGameStatTimer(void) {
+   struct timespec time;
+   timespec_get(&time, TIME_UTC);
+   return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
 }
 
-void startGame(Game* game) {
-   TetrominoPixelArray temp = game->activeTetromino->pixels;
-   game->getNextTetromino(game->nextTetromino);
-   game->activeTetromino->pixels = game->nextTetromino->pixels;
-   game->activeTetromino->size = game->nextTetromino->size;
-   game->activeTetromino->x = game->width / 2 - game->activeTetromino->size / 2;
-   game->activeTetromino->y = game->height;
-   game->nextTetromino->pixels = temp;
-   game->getNextTetromino(game->nextTetromino);
-   game->status = playGameStatus;
+/*!
+ * \brief Объявляет переменную \a timer и запоминает в ней время начала
+ * замера.
+ */
+#define startGameStatTimer(timer) uint64_t timer = readGameStatTimer()
+
+/*!
+ * \brief Прибавляет время, прошедшее с #startGameStatTimer, к счетчику
+ * \a counter из #GameStats.
+ */
+#define stopGameStatTimer(game, counter, timer) addGameStat(game, counter, readGameStatTimer() - (timer))
+#else
+#define startGameStatTimer(timer) ((void) 0)
+#define stopGameStatTimer(game, counter, timer) ((void) 0)
+#endif
+
+/*!
+ * \brief Возвращает указатель на первое слово строки битовой доски.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in] y y-координата строки. Может принимать значения
+ * [-#occupancyPadding .. #Game::height + #occupancyPadding)
+ * 
+ * \return указатель на первое слово строки
+ */
+static inline uint64_t* getOccupancyRow(const Game* game, int y) {
+   return game->occupancy + (y + occupancyPadding) * getGameOccupancyRowWords(game);
 }
 
-TetrominoPixel getGameFieldPixel(Game* game, int8_t x, int8_t y) {
-   if (x < 0 || x >= game->width) {
-      return 1;
-   }
-   if (y < 0) {
-      return 1;
+/*!
+ * \brief Заполняет битовую доску пустым игровым стаканом: стенами, дном и
+ * пустым местом над стаканом.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void initOccupancy(Game* game) {
+   size_t rowSize = getGameOccupancyRowWords(game) * sizeof(uint64_t);
+   memset(getOccupancyRow(game, -occupancyPadding), 0xFF, occupancyPadding * rowSize);
+   // стены: все биты вне [occupancyPadding .. occupancyPadding + width)
+   uint64_t* emptyRow = getOccupancyRow(game, 0);
+   for (int word = 0; word < getGameOccupancyRowWords(game); ++word) {
+      int firstBit = occupancyPadding - word * 64;
+      int lastBit = occupancyPadding + getGameWidth(game) - word * 64;
+      firstBit = firstBit < 0 ? 0 : firstBit;
+      lastBit = lastBit > 64 ? 64 : lastBit;
+      uint64_t fieldBits = 0;
+      if (firstBit < lastBit) {
+         fieldBits = (lastBit - firstBit == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << (lastBit - firstBit)) - 1) << firstBit;
+      }
+      emptyRow[word] = ~fieldBits;
    }
-   if (y >= game->height) {
-      return 0;
+   for (int y = 1; y < getGameHeight(game) + occupancyPadding; ++y) {
+      memcpy(getOccupancyRow(game, y), emptyRow, rowSize);
    }
-   return flatArrayAs2D(game->gameField, x, y, game->width);
 }
 
 /*!
- * \brief Устанавливает пиксел в игровом стакане.
+ * \brief Возвращает маску занятости #tetrominoMaxSize пикселов строки
+ * битовой доски, начиная с пиксела \a x:y.
  * 
- * \note Если пиксел находится вовне игрового стакана, то ничего не установит.
+ * \param[in] game указатель на структуру
+ * \param[in] x x-координата первого пиксела. Может принимать значения
+ * [-#occupancyPadding .. #Game::width]
+ * \param[in] y y-координата строки. Может принимать значения
+ * [-#occupancyPadding .. #Game::height + #occupancyPadding)
  * 
- * \param[in,out] game указатель на структуру
- * \param[in] pixel пиксел
- * \param[in] x x-координата пиксела
- * \param[in] y y-координата пиксела
+ * \return маска, где бит с номером \a i установлен, если пиксел \a x + \a i
+ * занят
  */
-void setPixel(Game* game, TetrominoPixel pixel, int8_t x, int8_t y) {
-   if (x < 0 || x >= game->width) {
-      return;
+static inline unsigned getOccupancyWindow(const Game* game, int x, int y) {
+   const uint64_t* row = getOccupancyRow(game, y);
+   unsigned bit = x + occupancyPadding;
+   unsigned shift = bit & 63;
+   uint64_t window = row[bit >> 6] >> shift;
+   if (shift > 64 - tetrominoMaxSize) {
+      window |= row[(bit >> 6) + 1] << (64 - shift);
    }
-   if (y < 0) {
-      return;
-   }
-   if (y >= game->height) {
-      return;
+   return (unsigned) window & ((1u << tetrominoMaxSize) - 1);
+}
+
+/*!
+ * \brief Возвращает маску занятости \a count пикселов строки битовой доски,
+ * начиная с пиксела \a x:y.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in] x x-координата первого пиксела. Может принимать значения
+ * [-#occupancyPadding .. #Game::width + #occupancyPadding - \a count]
+ * \param[in] y y-координата строки. Может принимать значения
+ * [-#occupancyPadding .. #Game::height + #occupancyPadding)
+ * \param[in] count количество пикселов. Не больше \a 32
+ * 
+ * \return маска, где бит с номером \a i установлен, если пиксел \a x + \a i
+ * занят
+ * 
+ * \see #getOccupancyWindow
+ */
+static inline unsigned getOccupancyBits(const Game* game, int x, int y, int count) {
+   const uint64_t* row = getOccupancyRow(game, y);
+   unsigned bit = x + occupancyPadding;
+   unsigned shift = bit & 63;
+   uint64_t bits = row[bit >> 6] >> shift;
+   if (shift > 64u - count) {
+      bits |= row[(bit >> 6) + 1] << (64 - shift);
    }
-   flatArrayAs2D(game->gameField, x, y, game->width) = pixel;
+   return (unsigned) (bits & (((uint64_t) 1 << count) - 1));
 }
 
 /*!
- * \brief Может ли активное тетрамино подвинутся вниз?
+ * \brief Устанавливает в битовой доске биты пикселов строки \a y, начиная
+ * с пиксела \a x.
  * 
- * \warning В игровом стакане должна отсутствовать информация об активном
- * тетрамино.
+ * \param[in,out] game указатель на структуру
+ * \param[in] bits маска из #tetrominoMaxSize бит
+ * \param[in] x x-координата первого пиксела
+ * \param[in] y y-координата строки
+ * 
+ * \see #getOccupancyWindow
+ */
+static inline void setOccupancyWindow(Game* game, unsigned bits, int x, int y) {
+   uint64_t* row = getOccupancyRow(game, y);
+   unsigned bit = x + occupancyPadding;
+   unsigned shift = bit & 63;
+   row[bit >> 6] |= (uint64_t) bits << shift;
+   if (shift > 64 - tetrominoMaxSize) {
+      row[(bit >> 6) + 1] |= (uint64_t) bits >> (64 - shift);
+   }
+}
+
+/*!
+ * \brief Пересекается ли маска тетрамино, расположенная в \a x:y, с занятыми
+ * пикселами битовой доски?
  * 
  * \param[in] game указатель на структуру
+ * \param[in] mask маска тетрамино (см. #ActiveTetromino::masks)
+ * \param[in] x x-координата начала координат маски
+ * \param[in] y y-координата начала координат маски
  * 
- * \return  
- *          - 1) \a 0 если не может
- *          - 2) \a 1 если может
+ * \return
+ *          - 1) \a 0 если не пересекается
+ *          - 2) \a 1 если пересекается
  */
-unsigned canActiveTetrominoMoveDown(Game* game) {
-   for (int y = 0; y < tetrominoMaxSize; ++y) {
-      for (int x = 0; x < tetrominoMaxSize; ++x) {
-         if(flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize)) {
-            if(getGameFieldPixel(game, game->activeTetromino->x + x, game->activeTetromino->y + y - 1)) {
-               return 0;
-            }
-         }
+static inline unsigned isMaskColliding(const Game* game, unsigned mask, int x, int y) {
+   countGameStat(game, collisionChecks);
+   for (; mask; mask >>= tetrominoMaxSize, ++y) {
+      unsigned rowMask = mask & ((1u << tetrominoMaxSize) - 1);
+      if (!rowMask) {
+         continue;
+      }
+      countGameStat(game, collisionRowProbes);
+      if (getOccupancyWindow(game, x, y) & rowMask) {
+         return 1;
       }
    }
-   return 1;
+   return 0;
 }
 
 /*!
- * \brief Может ли активное тетрамино повернутся по часовой стрелке?
- * 
- * \warning В игровом стакане должна отсутствовать информация об активном
- * тетрамино.
+ * \brief Вычисляет маску пикселов, через которые проходит тетрамино при
+ * повороте по часовой стрелке.
  * 
- * \param[in] game указатель на структуру
+ * \param[in] mask маска тетрамино (см. #ActiveTetromino::masks)
+ * \param[in] size размер тетрамино
  * 
- * \return  
- *          - 1) \a 0 если не может
- *          - 2) \a 1 если может
+ * \return маска (см. #ActiveTetromino::clockwiseSweepMasks)
  */
-unsigned canActiveTetrominoRotateClockwise(Game* game) {
-   double tetrominoCenter = ((double) (game->activeTetromino->size - 1)) / 2.;
-   for (int sourceY = 0; sourceY < game->activeTetromino->size; ++sourceY) {
-      for (int sourceX = 0; sourceX < game->activeTetromino->size; ++sourceX) {
-         if(flatArrayAs2D(game->activeTetromino->pixels, sourceX, sourceY, tetrominoMaxSize)) {
-            double relativeSourceX = (double) sourceX - tetrominoCenter;
-            double relativeSourceY = (double) sourceY - tetrominoCenter;
-            double relativeTargetX = relativeSourceY;
-            double relativeTargetY = -relativeSourceX;
-            int targetX = (int) round(relativeTargetX + tetrominoCenter);
-            int targetY = (int) round(relativeTargetY + tetrominoCenter);
+TETRIS_ENGINE_API uint16_t computeClockwiseSweepMask(uint16_t mask, int8_t size) {
+   uint16_t sweepMask = 0;
+   // удвоенные координаты центра и пикселов относительно центра, чтобы
+   // оставаться в целых числах и для тетрамино четного размера
+   int doubledCenter = size - 1;
+   for (int sourceY = 0; sourceY < size; ++sourceY) {
+      for (int sourceX = 0; sourceX < size; ++sourceX) {
+         if (mask & (1u << (sourceY * tetrominoMaxSize + sourceX))) {
+            int relativeSourceX = 2 * sourceX - doubledCenter;
+            int relativeSourceY = 2 * sourceY - doubledCenter;
+            int targetX = sourceY;
+            int targetY = doubledCenter - sourceX;
+            // конечный пиксел должен быть свободен всегда, в том числе для
+            // пикселов на диагонали, для которых проход ниже его не задевает
+            sweepMask |= 1u << (targetY * tetrominoMaxSize + targetX);
             if (relativeSourceX > relativeSourceY) {
                // низ право
-               if (fabs(relativeSourceX) > fabs(relativeSourceY)) {
+               if (abs(relativeSourceX) > abs(relativeSourceY)) {
                   // право
                   // -y, -x
                   for (int checkY = sourceY; checkY >= targetY; --checkY) {
-                     if(getGameFieldPixel(game, sourceX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + sourceX);
                   }
                   for (int checkX = sourceX; checkX >= targetX; --checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, targetY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (targetY * tetrominoMaxSize + checkX);
                   }
                } else {
                   // низ
                   // -x, +y
                   for (int checkX = sourceX; checkX >= targetX; --checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, sourceY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (sourceY * tetrominoMaxSize + checkX);
                   }
                   for (int checkY = sourceY; checkY <= targetY; ++checkY) {
-                     if(getGameFieldPixel(game, targetX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + targetX);
                   }
                }
             } else {
                // верх лево
-               if (fabs(relativeSourceX) > fabs(relativeSourceY)) {
+               if (abs(relativeSourceX) > abs(relativeSourceY)) {
                   // лево
                   // +y, +x
                   for (int checkY = sourceY; checkY <= targetY; ++checkY) {
-                     if(getGameFieldPixel(game, sourceX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + sourceX);
                   }
                   for (int checkX = sourceX; checkX <= targetX; ++checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, targetY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (targetY * tetrominoMaxSize + checkX);
                   }
                } else {
                   // верх
                   // +x, -y
                   for (int checkX = sourceX; checkX <= targetX; ++checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, sourceY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (sourceY * tetrominoMaxSize + checkX);
                   }
                   for (int checkY = sourceY; checkY >= targetY; --checkY) {
-                     if(getGameFieldPixel(game, targetX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + targetX);
                   }
                }
             }
          }
       }
    }
-   return 1;
+   return sweepMask;
 }
 
 /*!
- * \brief Может ли активное тетрамино повернутся против часовой стрелки?
- * 
- * \warning В игровом стакане должна отсутствовать информация об активном
- * тетрамино.
+ * \brief Вычисляет маску пикселов, через которые проходит тетрамино при
+ * повороте против часовой стрелки.
  * 
- * \param game указатель на структуру
+ * \param[in] mask маска тетрамино (см. #ActiveTetromino::masks)
+ * \param[in] size размер тетрамино
  * 
- * \return  
- *          - 1) \a 0 если не может
- *          - 2) \a 1 если может
+ * \return маска (см. #ActiveTetromino::againstClockwiseSweepMasks)
  */
-unsigned canActiveTetrominoRotateAgainstClockwise(Game* game) {
-   double tetrominoCenter = ((double) (game->activeTetromino->size - 1)) / 2.;
-   for (int sourceY = 0; sourceY < game->activeTetromino->size; ++sourceY) {
-      for (int sourceX = 0; sourceX < game->activeTetromino->size; ++sourceX) {
-         if(flatArrayAs2D(game->activeTetromino->pixels, sourceX, sourceY, tetrominoMaxSize)) {
-            double relativeSourceX = (double) sourceX - tetrominoCenter;
-            double relativeSourceY = (double) sourceY - tetrominoCenter;
-            double relativeTargetX = -relativeSourceY;
-            double relativeTargetY = relativeSourceX;
-            int targetX = (int) round(relativeTargetX + tetrominoCenter);
-            int targetY = (int) round(relativeTargetY + tetrominoCenter);
+TETRIS_ENGINE_API uint16_t computeAgainstClockwiseSweepMask(uint16_t mask, int8_t size) {
+   uint16_t sweepMask = 0;
+   // удвоенные координаты центра и пикселов относительно центра, чтобы
+   // оставаться в целых числах и для тетрамино четного размера
+   int doubledCenter = size - 1;
+   for (int sourceY = 0; sourceY < size; ++sourceY) {
+      for (int sourceX = 0; sourceX < size; ++sourceX) {
+         if (mask & (1u << (sourceY * tetrominoMaxSize + sourceX))) {
+            int relativeSourceX = 2 * sourceX - doubledCenter;
+            int relativeSourceY = 2 * sourceY - doubledCenter;
+            int targetX = doubledCenter - sourceY;
+            int targetY = sourceX;
+            // конечный пиксел должен быть свободен всегда, в том числе для
+            // пикселов на диагонали, для которых проход ниже его не задевает
+            sweepMask |= 1u << (targetY * tetrominoMaxSize + targetX);
             if (relativeSourceX > relativeSourceY) {
                // низ право
-               if (fabs(relativeSourceX) > fabs(relativeSourceY)) {
+               if (abs(relativeSourceX) > abs(relativeSourceY)) {
                   // право
                   // +y, -x
                   for (int checkY = sourceY; checkY <= targetY; ++checkY) {
-                     if(getGameFieldPixel(game, sourceX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + sourceX);
                   }
                   for (int checkX = sourceX; checkX >= targetX; --checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, targetY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (targetY * tetrominoMaxSize + checkX);
                   }
                } else {
                   // низ
                   // +x, +y
                   for (int checkX = sourceX; checkX <= targetX; ++checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, sourceY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (sourceY * tetrominoMaxSize + checkX);
                   }
                   for (int checkY = sourceY; checkY <= targetY; ++checkY) {
-                     if(getGameFieldPixel(game, targetX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + targetX);
                   }
                }
             } else {
                // верх лево
-               if (fabs(relativeSourceX) > fabs(relativeSourceY)) {
+               if (abs(relativeSourceX) > abs(relativeSourceY)) {
                   // лево
                   // -y, +x
                   for (int checkY = sourceY; checkY >= targetY; --checkY) {
-                     if(getGameFieldPixel(game, sourceX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + sourceX);
                   }
                   for (int checkX = sourceX; checkX <= targetX; ++checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, targetY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (targetY * tetrominoMaxSize + checkX);
                   }
                } else {
                   // верх
                   // -x, -y
                   for (int checkX = sourceX; checkX >= targetX; --checkX) {
-                     if(getGameFieldPixel(game, checkX + game->activeTetromino->x, sourceY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (sourceY * tetrominoMaxSize + checkX);
                   }
                   for (int checkY = sourceY; checkY >= targetY; --checkY) {
-                     if(getGameFieldPixel(game, targetX + game->activeTetromino->x, checkY + game->activeTetromino->y)) {
-                        return 0;
-                     }
+                     sweepMask |= 1u << (checkY * tetrominoMaxSize + targetX);
                   }
                }
             }
          }
       }
    }
-   return 1;
+   return sweepMask;
 }
 
 /*!
- * \brief Заносит информацию об активном тетрамино в игровой стакан.
+ * \brief Вычисляет маску занятых пикселов тетрамино.
  * 
- * \warning Каких-либо проверок не производит.
+ * \param[in] pixels массив пикселов тетрамино
  * 
- * \param[in,out] game указатель на структуру
+ * \return маска (см. #ActiveTetromino::masks)
  */
-void pushActiveTetrominoInfo(Game* game) {
-   for (int y = 0; y < game->activeTetromino->size; ++y) {
-      for (int x = 0; x < game->activeTetromino->size; ++x) {
-         TetrominoPixel tetrominoPixel = flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize);
-         if (tetrominoPixel) {
-            setPixel(game, tetrominoPixel, game->activeTetromino->x + x, game->activeTetromino->y + y);
-         }
+TETRIS_ENGINE_API uint16_t computeTetrominoMask(const TetrominoPixelArray pixels) {
+   uint16_t mask = 0;
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      if (pixels[i]) {
+         mask |= 1u << i;
       }
    }
+   return mask;
 }
 
 /*!
- * \brief Удаляет информацию об активном тетрамино из игрового стакана.
+ * \brief Поворачивает маску тетрамино по часовой стрелке.
  * 
- * \warning Каких-либо проверок не производит.
+ * Пиксел \a x:y переходит в пиксел \a y:(size - 1 - x). Пикселы вне
+ * квадрата \a size x \a size теряются, как и при повороте пикселов.
  * 
- * \param[in,out] game указатель на структуру
+ * \param[in] mask маска (см. #ActiveTetromino::masks)
+ * \param[in] size размер тетрамино
+ * 
+ * \return маска повернутого тетрамино
  */
-void popActiveTetrominoInfo(Game* game) {
-   for (int y = 0; y < game->activeTetromino->size; ++y) {
-      for (int x = 0; x < game->activeTetromino->size; ++x) {
-         if (flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize)) {
-            setPixel(game, 0, game->activeTetromino->x + x, game->activeTetromino->y + y);
+static uint16_t rotateTetrominoMask(uint16_t mask, int8_t size) {
+   uint16_t rotated = 0;
+   for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+         if (mask & (1u << (y * tetrominoMaxSize + x))) {
+            rotated |= 1u << ((size - 1 - x) * tetrominoMaxSize + y);
          }
       }
    }
+   return rotated;
 }
 
 /*!
- * \brief Если это возможно, двигает активное тетрамино вниз на одну строчку.
- *
- * \note На момент вызова функции информация об активном тетрамино должна быть
- * в игровом стакане. После работы функции и при удаче, и при неудаче
- * информация об активном тетрамино будет в игровом стакане.
+ * \brief Вычисляет прямоугольник занятых пикселов маски.
  * 
- * \param[in,out] game указатель на структуру
+ * \param[in] mask маска (см. #ActiveTetromino::masks)
  * 
- * \return  
- *          - 1) \a 0 если не может
- *          - 2) \a 1 если может
+ * \return прямоугольник. Для пустой маски все поля равны \a 0
  */
-unsigned moveActiveTetrominoDown(Game* game) {
-   popActiveTetrominoInfo(game);
-   if (canActiveTetrominoMoveDown(game)) {
-      --game->activeTetromino->y;
-      pushActiveTetrominoInfo(game);
-      return 1;
-   } else {
-      pushActiveTetrominoInfo(game);
-      return 0;
+static TetrominoBounds computeTetrominoBounds(unsigned mask) {
+   TetrominoBounds bounds = {0, 0, 0, 0};
+   if (!mask) {
+      return bounds;
    }
-}
-
-unsigned rotateClockwise(Game* game) {
-   popActiveTetrominoInfo(game);
-   if (canActiveTetrominoRotateClockwise(game)) {
-      TetrominoPixel tempTetrominoBuffer[tetrominoArrayMaxSize] = {0};
-      double tetrominoCenter = ((double) (game->activeTetromino->size - 1)) / 2.;
-      for (int sourceY = 0; sourceY < game->activeTetromino->size; ++sourceY) {
-         for (int sourceX = 0; sourceX < game->activeTetromino->size; ++sourceX) {
-            TetrominoPixel tetrominoPixel = flatArrayAs2D(game->activeTetromino->pixels, sourceX, sourceY, tetrominoMaxSize);
-            if(tetrominoPixel) {
-               double relativeSourceX = (double) sourceX - tetrominoCenter;
-               double relativeSourceY = (double) sourceY - tetrominoCenter;
-               double relativeTargetX = relativeSourceY;
-               double relativeTargetY = -relativeSourceX;
-               int targetX = (int) round(relativeTargetX + tetrominoCenter);
-               int targetY = (int) round(relativeTargetY + tetrominoCenter);
-               flatArrayAs2D(tempTetrominoBuffer, targetX, targetY, tetrominoMaxSize) = tetrominoPixel;
-            }
+   int minX = tetrominoMaxSize;
+   int maxX = 0;
+   int minY = tetrominoMaxSize;
+   int maxY = 0;
+   for (int y = 0; mask; mask >>= tetrominoMaxSize, ++y) {
+      unsigned rowMask = mask & ((1u << tetrominoMaxSize) - 1);
+      if (!rowMask) {
+         continue;
+      }
+      minY = y < minY ? y : minY;
+      maxY = y;
+      for (int x = 0; x < tetrominoMaxSize; ++x) {
+         if (rowMask & (1u << x)) {
+            minX = x < minX ? x : minX;
+            maxX = x > maxX ? x : maxX;
          }
       }
-      memcpy(game->activeTetromino->pixels, &tempTetrominoBuffer, tetrominoArrayMaxSize);
-      pushActiveTetrominoInfo(game);
-      return 0;
-   } else {
-      pushActiveTetrominoInfo(game);
-      return 1;
    }
+   bounds.x = (int8_t) minX;
+   bounds.y = (int8_t) minY;
+   bounds.width = (int8_t) (maxX - minX + 1);
+   bounds.height = (int8_t) (maxY - minY + 1);
+   return bounds;
 }
 
-unsigned rotateAgainstClockwise(Game* game) {
-   popActiveTetrominoInfo(game);
-   if (canActiveTetrominoRotateAgainstClockwise(game)) {
-      TetrominoPixel tempTetrominoBuffer[tetrominoArrayMaxSize] = {0};
-      double tetrominoCenter = ((double) (game->activeTetromino->size - 1)) / 2.;
-      for (int sourceY = 0; sourceY < game->activeTetromino->size; ++sourceY) {
-         for (int sourceX = 0; sourceX < game->activeTetromino->size; ++sourceX) {
-            TetrominoPixel tetrominoPixel = flatArrayAs2D(game->activeTetromino->pixels, sourceX, sourceY, tetrominoMaxSize);
-            if(tetrominoPixel) {
-               double relativeSourceX = (double) sourceX - tetrominoCenter;
-               double relativeSourceY = (double) sourceY - tetrominoCenter;
-               double relativeTargetX = -relativeSourceY;
-               double relativeTargetY = relativeSourceX;
-               int targetX = (int) round(relativeTargetX + tetrominoCenter);
-               int targetY = (int) round(relativeTargetY + tetrominoCenter);
-               flatArrayAs2D(tempTetrominoBuffer, targetX, targetY, tetrominoMaxSize) = tetrominoPixel;
+/*!
+ * \brief Вычисляет все данные формы тетрамино по маске поворота \a 0.
+ * 
+ * \param[out] shape форма
+ * \param[in] mask маска поворота \a 0
+ * \param[in] size размер тетрамино
+ */
+static void computeTetrominoShape(TetrominoShape* shape, uint16_t mask, int8_t size) {
+   shape->size = size;
+   for (int orientation = 0; orientation < tetrominoOrientationCount; ++orientation) {
+      if (orientation) {
+         mask = rotateTetrominoMask(mask, size);
+      }
+      shape->masks[orientation] = mask;
+      shape->clockwiseSweepMasks[orientation] = computeClockwiseSweepMask(mask, size);
+      shape->againstClockwiseSweepMasks[orientation] = computeAgainstClockwiseSweepMask(mask, size);
+      for (int x = 0; x < tetrominoMaxSize; ++x) {
+         int8_t bottom = -1;
+         for (int y = tetrominoMaxSize - 1; y >= 0; --y) {
+            if (mask & (1u << (y * tetrominoMaxSize + x))) {
+               bottom = y;
             }
          }
+         shape->columnBottoms[orientation][x] = bottom;
       }
-      memcpy(game->activeTetromino->pixels, &tempTetrominoBuffer, tetrominoArrayMaxSize);
-      pushActiveTetrominoInfo(game);
-      return 0;
-   } else {
-      pushActiveTetrominoInfo(game);
-      return 1;
+      shape->bounds[orientation] = computeTetrominoBounds(mask);
    }
 }
 
 /*!
- * \brief Очищает полностью занятые строки.
+ * \brief Возвращает ячейку хеш-индекса таблицы форм, с которой начинается
+ * поиск формы.
  * 
- * \param game[in,out] указатель на структуру
+ * \param[in] mask маска поворота \a 0
+ * \param[in] size размер тетрамино
  * 
- * \return кол-во очищенный строк
+ * \return ячейка
  */
-int8_t cleanLines(Game* game) {
-   int8_t cleanedLines = 0;
-   for (int8_t y = game->height - 1; y >= 0; --y) {
-      unsigned isLineFull = 1;
-      for (int8_t x = 0; x < game->width; ++x) {
-         if (!getGameFieldPixel(game, x, y)) {
-            isLineFull = 0;
-            break;
-         }
-      }
-      if (isLineFull) {
-         // сдвинуть линии
-         memmove(&flatArrayAs2D(game->gameField, 0, y, game->width), 
-               &flatArrayAs2D(game->gameField, 0, y + 1, game->width),
-               (game->height - y - 1) * game->width);
-         // заполнить последную линию нулями
-         memset(&flatArrayAs2D(game->gameField, 0, game->height - 1, game->width), 0, sizeof(TetrominoPixel) * game->width);
-         ++cleanedLines;
+static inline unsigned hashTetrominoShape(uint16_t mask, int8_t size) {
+   uint32_t key = (uint32_t) mask << 8 | (uint8_t) size;
+   return (key * 2654435761u) >> 16 & (tetrominoShapeIndexSize - 1);
+}
+
+/*!
+ * \brief Находит форму в таблице форм игры, а если ее нет, вычисляет и
+ * добавляет.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] mask маска поворота \a 0
+ * \param[in] size размер тетрамино
+ * 
+ * \return номер формы или #noTetrominoShape, если формы нет и таблица
+ * заполнена
+ */
+static uint8_t internTetrominoShape(Game* game, uint16_t mask, int8_t size) {
+   TetrominoShapeTable* table = &game->shapeTable;
+   // ячеек вдвое больше, чем форм, поэтому пустая ячейка всегда найдется
+   unsigned slot = hashTetrominoShape(mask, size);
+   for (; table->index[slot] != noTetrominoShape; slot = (slot + 1) & (tetrominoShapeIndexSize - 1)) {
+      const TetrominoShape* shape = table->shapes + table->index[slot];
+      if (shape->masks[0] == mask && shape->size == size) {
+         return table->index[slot];
       }
    }
-   return cleanedLines;
+   countGameStat(game, shapeMisses);
+   if (table->count == tetrominoShapeCapacity) {
+      return noTetrominoShape;
+   }
+   uint8_t shape = table->count++;
+   computeTetrominoShape(table->shapes + shape, mask, size);
+   table->index[slot] = shape;
+   return shape;
 }
 
 /*!
- * \brief Находится ли активное тетрамино полностью в игровом стакане.
+ * \brief Добавляет форму активного тетрамино в таблицу форм игры после
+ * копирования тетрамино из другой игры или снимка.
  * 
- * Проверяет только на нахождение прямо сверху от игрового стакана.
+ * \param[in,out] game указатель на структуру
+ */
+static void internActiveTetrominoShape(Game* game) {
+   ActiveTetromino* activeTetromino = game->activeTetromino;
+   activeTetromino->shape = game->status == initGameStatus ? noTetrominoShape
+         : internTetrominoShape(game, activeTetromino->masks[0], activeTetromino->size);
+}
+
+/*!
+ * \brief Возвращает прямоугольник занятых пикселов текущего поворота
+ * активного тетрамино: из таблицы форм или, если формы там нет, по маске.
  * 
- * \param game[in] указатель на структуру
+ * \param[in] game указатель на структуру
  * 
- * \return  
- *          - 1) \a 0 если как минимум часть тетрамино находится во вне 
- * игрового стакана
- *          - 2) \a 1 если тетрамино полностью находится в игровом стакане
+ * \return прямоугольник в координатах массива пикселов тетрамино
  */
-unsigned isActiveTetrominoInGameBoard(Game* game) {
-   for (int8_t y = game->activeTetromino->size - 1; y >= 0; --y) {
-      for (int8_t x = 0; x < game->activeTetromino->size; ++x) {
-         if (flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize)) {
-            if (game->activeTetromino->y + y >= game->height) {
-               return 0;
-            }
-         }
-      }
+static inline TetrominoBounds getActiveTetrominoBounds(const Game* game) {
+   const ActiveTetromino* activeTetromino = game->activeTetromino;
+   if (activeTetromino->shape == noTetrominoShape) {
+      return computeTetrominoBounds(activeTetromino->masks[activeTetromino->orientation]);
    }
-   return 1;
+   return game->shapeTable.shapes[activeTetromino->shape].bounds[activeTetromino->orientation];
 }
 
-unsigned tick(Game* game) {;
-   if (!moveActiveTetrominoDown(game)) {
-      if(!isActiveTetrominoInGameBoard(game)) {
-         game->status = endPlayerLoose;
-         return 3;
-      } else {
-         int8_t cleanedLines = cleanLines(game);
-         uint32_t scoredAddend = game->getScoreAddend(cleanedLines);
-         uint32_t scoreCopy = game->score;
-         scoreCopy += scoredAddend;
-         if (scoreCopy < game->score || scoreCopy > game->maxScore) {
-            game->score = game->maxScore;
-            game->status = endMaxScoreStatus;
-            return 2;
+/*!
+ * \brief Делает тетрамино активным: вычисляет все его повороты и их маски и
+ * помещает его над игровым стаканом.
+ * 
+ * Поворот по часовой стрелке переводит пиксел \a x:y в пиксел
+ * \a y:(size - 1 - x).
+ * 
+ * Маски, маски поворотов и нижние пикселы столбцов берутся из таблицы форм
+ * (#Game::shapeTable) и вычисляются только для новой формы. Пикселы
+ * одноцветного тетрамино заполняются по маскам, многоцветного -
+ * поворачиваются.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] tetromino тетрамино, которое станет активным
+ * \param[in] x x-координата активного тетрамино
+ */
+TETRIS_ENGINE_API void setActiveTetromino(Game* game, const NextTetromino* tetromino, GameCoordinate x) {
+   ActiveTetromino* activeTetromino = game->activeTetromino;
+   int8_t size = tetromino->size;
+   uint16_t mask = 0;
+   TetrominoPixel color = 0;
+   unsigned isSingleColor = 1;
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      TetrominoPixel pixel = tetromino->pixels[i];
+      if (pixel) {
+         mask |= 1u << i;
+         isSingleColor &= !color || pixel == color;
+         color = pixel;
+      }
+   }
+   TetrominoShape computedShape;
+   const TetrominoShape* shape;
+   activeTetromino->shape = internTetrominoShape(game, mask, size);
+   if (activeTetromino->shape == noTetrominoShape) {
+      computeTetrominoShape(&computedShape, mask, size);
+      shape = &computedShape;
+   } else {
+      shape = game->shapeTable.shapes + activeTetromino->shape;
+   }
+   memcpy(activeTetromino->masks, shape->masks, sizeof(shape->masks));
+   memcpy(activeTetromino->clockwiseSweepMasks, shape->clockwiseSweepMasks, sizeof(shape->clockwiseSweepMasks));
+   memcpy(activeTetromino->againstClockwiseSweepMasks, shape->againstClockwiseSweepMasks,
+         sizeof(shape->againstClockwiseSweepMasks));
+   memcpy(activeTetromino->columnBottoms, shape->columnBottoms, sizeof(shape->columnBottoms));
+   memcpy(activeTetromino->orientationPixels, tetromino->pixels, tetrominoArrayMaxSize);
+   for (int orientation = 1; orientation < tetrominoOrientationCount; ++orientation) {
+      TetrominoPixel* target = activeTetromino->orientationPixels + orientation * tetrominoArrayMaxSize;
+      if (isSingleColor) {
+         for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+            target[i] = (shape->masks[orientation] >> i) & 1 ? color : 0;
+         }
+         continue;
+      }
+      const TetrominoPixel* source = activeTetromino->orientationPixels + (orientation - 1) * tetrominoArrayMaxSize;
+      memset(target, 0, tetrominoArrayMaxSize);
+      for (int sourceY = 0; sourceY < size; ++sourceY) {
+         for (int sourceX = 0; sourceX < size; ++sourceX) {
+            flatArrayAs2D(target, sourceY, size - 1 - sourceX, tetrominoMaxSize) =
+                  flatArrayAs2D(source, sourceX, sourceY, tetrominoMaxSize);
          }
-         game->score = scoreCopy;
-         // nextTetromino -> activeTetromino, init nextTetromino
-         TetrominoPixelArray activeTetrominoArray = game->activeTetromino->pixels;
-         game->activeTetromino->pixels = game->nextTetromino->pixels;
-         game->activeTetromino->size = game->nextTetromino->size;
-         game->activeTetromino->x = game->width / 2 - tetrominoMaxSize / 2;
-         game->activeTetromino->y = game->height;
-         game->nextTetromino->pixels = activeTetrominoArray;
-         game->getNextTetromino(game->nextTetromino);
-         return 1;
       }
    }
-   return 0;
+   activeTetromino->size = size;
+   activeTetromino->orientation = 0;
+   activeTetromino->pixels = activeTetromino->orientationPixels;
+   activeTetromino->x = x;
+   activeTetromino->y = getGameHeight(game);
 }
 
 /*!
- * \brief Двигает тетрамино влево.
+ * \brief Память, из которой собирается игра.
  * 
- * \param[in,out] game указатель на структуру
+ * Каждый указатель указывает на блок памяти нужного размера для своего поля
+ * (см. документацию полей #Game и #ActiveTetromino).
  * 
- * \return  
- *          - 1) \a 0 если тетрамино удалось подвинуть влево
- *          - 2) \a 1 если тетрамино не удалось подвинуть влево
+ * \warning Память раскладывают и #layoutGameMemory, и #initGameBatch:
+ * новое поле нужно добавить в обе.
  */
-unsigned moveLeft(Game* game) {
-   popActiveTetrominoInfo(game);
-   for (int y = 0; y < game->activeTetromino->size; ++y) {
-      for (int x = 0; x < game->activeTetromino->size; ++x) {
-         if(flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize)) {
-            if(getGameFieldPixel(game, game->activeTetromino->x + x - 1, game->activeTetromino->y + y)) {
-               pushActiveTetrominoInfo(game);
-               return 1;
-            }
-         }
-      }
-   }
-   --game->activeTetromino->x;
-   pushActiveTetrominoInfo(game);
-   return 0;
+typedef struct tagGameMemory {
+   Game* game;                            ///< сама игра
+   ActiveTetromino* activeTetromino;      ///< #Game::activeTetromino
+   NextTetromino* nextTetromino;          ///< #Game::nextTetromino
+   GameEvent* events;                     ///< #GameEventQueue::events
+   TetrominoShape* shapes;                ///< #TetrominoShapeTable::shapes
+   TetrominoPixelArray orientationPixels; ///< #ActiveTetromino::orientationPixels
+   TetrominoPixelArray queuePixels;       ///< #TetrominoQueue::pixels
+   int8_t* queueSizes;                    ///< #TetrominoQueue::sizes
+   TetrominoPixelArray gameField;         ///< #Game::gameField
+   uint64_t* occupancy;                   ///< #Game::occupancy
+   uint64_t* rowHashes;                   ///< #Game::rowHashes
+   uint64_t* dirtyRows;                   ///< #DirtyRegion::rows в #Game::dirtyRegion
+   GameCoordinate* columnHeights;         ///< #Game::columnHeights
+   GameCoordinate* rowFillCounts;         ///< #Game::rowFillCounts
+} GameMemory;
+
+/*!
+ * \brief Возвращает количество машинных слов в одной строке битовой доски.
+ * 
+ * \param[in] width ширина игрового стакана
+ * 
+ * \return количество слов
+ */
+static inline GameCoordinate getOccupancyRowWords(GameCoordinate width) {
+   return (width + 2 * occupancyPadding + 63) / 64;
 }
 
 /*!
- * \brief Двигает тетрамино вправо.
+ * \brief Округляет размер блока памяти вверх до выравнивания \a uint64_t.
  * 
- * \param[in,out] game указатель на структуру
+ * \param[in] size размер блока
  * 
- * \return
- *          - 1) \a 0 если тетрамино удалось подвинуть вправо
- *          - 2) \a 1 если тетрамино не удалось подвинуть вправо
+ * \return выровненный размер
  */
-unsigned moveRight(Game* game) {
-   popActiveTetrominoInfo(game);
-   for (int y = 0; y < game->activeTetromino->size; ++y) {
-      for (int x = 0; x < game->activeTetromino->size; ++x) {
-         if(flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize)) {
-            if(getGameFieldPixel(game, game->activeTetromino->x + x + 1, game->activeTetromino->y + y)) {
-               pushActiveTetrominoInfo(game);
-               return 1;
-            }
-         }
-      }
-   }
-   ++game->activeTetromino->x;
-   pushActiveTetrominoInfo(game);
-   return 0;
+static inline size_t alignMemoryBlock(size_t size) {
+   return (size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
 }
 
-void freeGame(Game* game) {
-   if (game) {
-      if (game->activeTetromino) {
-         free(game->activeTetromino->pixels);
-      }
-      free(game->activeTetromino);
-      if (game->nextTetromino) {
-         free(game->nextTetromino->pixels);
-      }
-      free(game->nextTetromino);
-      free(game->gameField);
-   }
-   free(game);
+/*!
+ * \brief Собирает игру из уже выделенной памяти и инициализирует её.
+ * 
+ * В #Game::status записывает #initGameStatus.
+ * 
+ * \param[in] memory память для игры
+ * \param[in] width ширина игрового стакана
+ * \param[in] height высота игрового стакана
+ * \param[in] maxScore максимально возможное количество очков
+ * \param[in] getNextTetrominoFunction функция, генерирующая следующее
+ * тетрамино
+ * \param[in] getScoreAddendFunction функция, вычисляющая количество очков,
+ * которое игрок заработал за заполнение строк
+ * 
+ * \return указатель на игру (равен \a memory->game)
+ */
+static Game* assembleGame(const GameMemory* memory, GameCoordinate width, GameCoordinate height, int32_t maxScore,
+      GetNextTetrominoFunction* const getNextTetrominoFunction, 
+      GetScoreAddendFunction* const getScoreAddendFunction) {
+   Game* game = memory->game;
+   game->status = initGameStatus;
+   *(GameCoordinate*) &game->width = width;
+   *(GameCoordinate*) &game->height = height;
+   game->score = 0;
+   *(uint32_t*) &game->maxScore = maxScore;
+   *(TetrominoPixelArray*) &game->gameField = memory->gameField;
+   memset(memory->gameField, 0, width * height * sizeof(TetrominoPixel));
+   *(GameFieldMode*) &game->fieldMode = compositeGameFieldMode;
+   *(uint64_t**) &game->occupancy = memory->occupancy;
+   *(GameCoordinate*) &game->occupancyRowWords = getOccupancyRowWords(width);
+   initOccupancy(game);
+   *(GameCoordinate**) &game->columnHeights = memory->columnHeights;
+   memset(memory->columnHeights, 0, width * sizeof(GameCoordinate));
+   *(GameCoordinate**) &game->rowFillCounts = memory->rowFillCounts;
+   memset(memory->rowFillCounts, 0, height * sizeof(GameCoordinate));
+   *(uint64_t**) &game->rowHashes = memory->rowHashes;
+   memset(memory->rowHashes, 0, height * sizeof(uint64_t));
+   game->boardHash = 0;
+   game->activeTetromino = memory->activeTetromino;
+   game->activeTetromino->orientationPixels = memory->orientationPixels;
+   game->activeTetromino->pixels = memory->orientationPixels;
+   game->activeTetromino->shape = noTetrominoShape;
+   game->nextTetromino = memory->nextTetromino;
+   game->nextTetromino->pixels = memory->queuePixels;
+   *(TetrominoPixelArray*) &game->tetrominoQueue.pixels = memory->queuePixels;
+   *(int8_t**) &game->tetrominoQueue.sizes = memory->queueSizes;
+   game->tetrominoQueue.head = 0;
+   game->tetrominoQueue.count = 0;
+   game->tetrominoQueue.total = 0;
+   memset(&game->tetrominoGenerator, 0, sizeof(TetrominoGenerator));
+   game->tetrominoGenerator.type = functionTetrominoGenerator;
+   *(GetNextTetrominoFunction**) &game->getNextTetromino = getNextTetrominoFunction;
+   *(GetScoreAddendFunction**) &game->getScoreAddend = getScoreAddendFunction;
+   memset(&game->boardFeatures, 0, sizeof(BoardFeatures));
+   // в пустой строке занятость меняется только у стен
+   game->boardFeatures.rowTransitions = 2 * (uint32_t) height;
+   memset(&game->dirtyRegion, 0, sizeof(DirtyRegion));
+   game->dirtyRegion.rows = memory->dirtyRows;
+   memset(memory->dirtyRows, 0, dirtyRowWords(height) * sizeof(uint64_t));
+   *(TetrominoShape**) &game->shapeTable.shapes = memory->shapes;
+   game->shapeTable.count = 0;
+   memset(game->shapeTable.index, noTetrominoShape, sizeof(game->shapeTable.index));
+   *(GameEvent**) &game->eventQueue.events = memory->events;
+   game->eventQueue.head = 0;
+   game->eventQueue.count = 0;
+   game->eventQueue.droppedEvents = 0;
+#ifdef TETRIS_ENGINE_GAME_VIEW
+   game->viewPublisher = NULL;
+#endif
+#ifdef TETRIS_ENGINE_STATS
+   memset(&game->stats, 0, sizeof(GameStats));
+#endif
+   return game;
+}
+
+/*!
+ * \brief Раскладывает все блоки памяти игры в одном непрерывном блоке.
+ * 
+ * Блоки идут в порядке убывания выравнивания: сначала структуры и битовая
+ * доска, затем массивы #GameCoordinate и байтовые массивы.
+ * 
+ * \param[in] block начало блока, выровненное как \a uint64_t. Может быть
+ * \a NULL, если нужен только размер
+ * \param[in] width ширина игрового стакана
+ * \param[in] height высота игрового стакана
+ * \param[out] memory указатели на блоки игры. Может быть \a NULL
+ * 
+ * \return размер всего блока в байтах
+ */
+static size_t layoutGameMemory(uint8_t* block, GameCoordinate width, GameCoordinate height, GameMemory* memory) {
+   size_t activeOffset = alignMemoryBlock(sizeof(Game));
+   size_t nextOffset = activeOffset + alignMemoryBlock(sizeof(ActiveTetromino));
+   size_t eventsOffset = nextOffset + alignMemoryBlock(sizeof(NextTetromino));
+   size_t shapesOffset = eventsOffset + alignMemoryBlock(gameEventQueueCapacity * sizeof(GameEvent));
+   size_t occupancyOffset = shapesOffset + alignMemoryBlock(tetrominoShapeCapacity * sizeof(TetrominoShape));
+   size_t rowHashesOffset = occupancyOffset
+         + (size_t) (height + 2 * occupancyPadding) * getOccupancyRowWords(width) * sizeof(uint64_t);
+   size_t dirtyRowsOffset = rowHashesOffset + height * sizeof(uint64_t);
+   size_t orientationOffset = dirtyRowsOffset + dirtyRowWords(height) * sizeof(uint64_t);
+   size_t queuePixelsOffset = orientationOffset + tetrominoOrientationCount * tetrominoArrayMaxSize * sizeof(TetrominoPixel);
+   size_t queueSizesOffset = queuePixelsOffset + tetrominoQueueCapacity * tetrominoArrayMaxSize * sizeof(TetrominoPixel);
+   size_t columnHeightsOffset = queueSizesOffset + tetrominoQueueCapacity * sizeof(int8_t);
+   size_t rowFillCountsOffset = columnHeightsOffset + width * sizeof(GameCoordinate);
+   size_t fieldOffset = rowFillCountsOffset + height * sizeof(GameCoordinate);
+   size_t totalSize = alignMemoryBlock(fieldOffset + (size_t) width * height * sizeof(TetrominoPixel));
+   if (memory) {
+      memory->game = (Game*) block;
+      memory->activeTetromino = (ActiveTetromino*) (block + activeOffset);
+      memory->nextTetromino = (NextTetromino*) (block + nextOffset);
+      memory->events = (GameEvent*) (block + eventsOffset);
+      memory->shapes = (TetrominoShape*) (block + shapesOffset);
+      memory->occupancy = (uint64_t*) (block + occupancyOffset);
+      memory->rowHashes = (uint64_t*) (block + rowHashesOffset);
+      memory->dirtyRows = (uint64_t*) (block + dirtyRowsOffset);
+      memory->orientationPixels = block + orientationOffset;
+      memory->queuePixels = block + queuePixelsOffset;
+      memory->queueSizes = (int8_t*) (block + queueSizesOffset);
+      memory->gameField = block + fieldOffset;
+      memory->columnHeights = (GameCoordinate*) (block + columnHeightsOffset);
+      memory->rowFillCounts = (GameCoordinate*) (block + rowFillCountsOffset);
+   }
+   return totalSize;
+}
+
+TETRIS_ENGINE_API size_t gameRequiredBytes(GameCoordinate width, GameCoordinate height) {
+   return layoutGameMemory(NULL, width, height, NULL);
+}
+
+TETRIS_ENGINE_API Game* initGameInPlace(void* memory, GameCoordinate width, GameCoordinate height, int32_t maxScore,
+      GetNextTetrominoFunction* const getNextTetrominoFunction, 
+      GetScoreAddendFunction* const getScoreAddendFunction) {
+   if (!memory || !isGameSizeSupported(width, height)) {
+      return NULL;
+   }
+   GameMemory gameMemory;
+   layoutGameMemory((uint8_t*) memory, width, height, &gameMemory);
+   return assembleGame(&gameMemory, width, height, maxScore, getNextTetrominoFunction, getScoreAddendFunction);
+}
+
+TETRIS_ENGINE_API Game* initGame(GameCoordinate width, GameCoordinate height, int32_t maxScore,
+      GetNextTetrominoFunction* const getNextTetrominoFunction, 
+      GetScoreAddendFunction* const getScoreAddendFunction) {
+   if (!isGameSizeSupported(width, height)) {
+      return NULL;
+   }
+   return initGameInPlace(malloc(gameRequiredBytes(width, height)), width, height, maxScore,
+         getNextTetrominoFunction, getScoreAddendFunction);
+}
+
+/*!
+ * \brief Маски стандартных тетрамино (см. #ActiveTetromino::masks), смещенные
+ * к началу координат.
+ */
+static const uint16_t standardTetrominoMasks[tetrominoKindCount] = {
+   0x000F, // I
+   0x0033, // O
+   0x0027, // T
+   0x0063, // S
+   0x0036, // Z
+   0x0017, // J
+   0x0047, // L
+};
+
+/*!
+ * \brief #NextTetromino::size стандартных тетрамино.
+ */
+static const int8_t standardTetrominoSizes[tetrominoKindCount] = {4, 2, 3, 3, 3, 3, 3};
+
+/*!
+ * \brief Возвращает следующее случайное число генератора (SplitMix64).
+ * 
+ * \param[in,out] generator генератор
+ * 
+ * \return случайное число
+ */
+static inline uint64_t nextGeneratorRandom(TetrominoGenerator* generator) {
+   uint64_t z = (generator->state += 0x9E3779B97F4A7C15ull);
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+   return z ^ (z >> 31);
+}
+
+/*!
+ * \brief Возвращает случайное число из [0 .. \a bound) без деления.
+ * 
+ * \param[in,out] generator генератор
+ * \param[in] bound верхняя граница
+ * 
+ * \return случайное число
+ */
+static inline unsigned nextGeneratorBounded(TetrominoGenerator* generator, unsigned bound) {
+   return (unsigned) (((nextGeneratorRandom(generator) >> 32) * bound) >> 32);
+}
+
+/*!
+ * \brief Возвращает вид следующего тетрамино встроенного генератора.
+ * 
+ * \param[in,out] generator генератор, отличный от
+ * #functionTetrominoGenerator
+ * 
+ * \return вид тетрамино
+ */
+static inline unsigned nextTetrominoKind(TetrominoGenerator* generator) {
+   switch (generator->type) {
+      case bagTetrominoGenerator:
+         if (generator->bagPosition >= tetrominoKindCount) {
+            for (unsigned i = tetrominoKindCount - 1; i > 0; --i) {
+               unsigned j = nextGeneratorBounded(generator, i + 1);
+               uint8_t kind = generator->bag[i];
+               generator->bag[i] = generator->bag[j];
+               generator->bag[j] = kind;
+            }
+            generator->bagPosition = 0;
+         }
+         return generator->bag[generator->bagPosition++];
+      case sequenceTetrominoGenerator: {
+         unsigned kind = generator->sequence[generator->sequencePosition];
+         if (++generator->sequencePosition == generator->sequenceLength) {
+            generator->sequencePosition = 0;
+         }
+         return kind % tetrominoKindCount;
+      }
+      default:
+         return nextGeneratorBounded(generator, tetrominoKindCount);
+   }
+}
+
+/*!
+ * \brief Пикселы, которые может занимать тетрамино размера \a size (см.
+ * #ActiveTetromino::masks). Размер меньше \a 2 не допускается.
+ */
+static const uint16_t tetrominoSizeMasks[tetrominoMaxSize + 1] = {0, 0, 0x0033, 0x0777, 0xFFFF};
+
+/*!
+ * \brief Читает следующее тетрамино из потока тетрамино журнала игры.
+ * 
+ * Тетрамино записано как #NextTetromino::size, маска (см.
+ * #ActiveTetromino::masks, два байта) и по одному байту на каждый занятый
+ * пиксел. Если поток закончился или тетрамино в нем испорчено, то
+ * возвращает O тетрамино: такая игра уже разошлась с журналом.
+ * 
+ * \param[in,out] generator генератор #logTetrominoGenerator. #TetrominoGenerator::sequence
+ * указывает на поток, #TetrominoGenerator::sequencePosition - на следующий
+ * байт
+ * \param[out] pixels пикселы тетрамино
+ * 
+ * \return #NextTetromino::size тетрамино
+ */
+static int8_t readLoggedTetromino(TetrominoGenerator* generator, TetrominoPixelArray pixels) {
+   const uint8_t* bytes = generator->sequence + generator->sequencePosition;
+   size_t left = generator->sequenceLength - generator->sequencePosition;
+   memset(pixels, 0, tetrominoArrayMaxSize * sizeof(TetrominoPixel));
+   if (left >= 3) {
+      int8_t size = (int8_t) bytes[0];
+      unsigned mask = bytes[1] | (unsigned) bytes[2] << 8;
+      size_t used = 3;
+      for (int i = 0; i < tetrominoArrayMaxSize && used < left; ++i) {
+         if ((mask >> i) & 1) {
+            pixels[i] = bytes[used++];
+         }
+      }
+      generator->sequencePosition += (unsigned) used;
+      if (size >= 2 && size <= tetrominoMaxSize && mask && !(mask & ~tetrominoSizeMasks[size])) {
+         return size;
+      }
+      memset(pixels, 0, tetrominoArrayMaxSize * sizeof(TetrominoPixel));
+   }
+   pixels[0] = pixels[1] = pixels[tetrominoMaxSize] = pixels[tetrominoMaxSize + 1] = 1;
+   return 2;
+}
+
+/*!
+ * \brief Заполняет очередь следующих тетрамино до #tetrominoQueueCapacity
+ * элементов.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void refillTetrominoQueue(Game* game) {
+   TetrominoQueue* queue = &game->tetrominoQueue;
+   TetrominoGenerator* generator = &game->tetrominoGenerator;
+   unsigned slot = (queue->head + queue->count) % tetrominoQueueCapacity;
+   for (; queue->count < tetrominoQueueCapacity; ++queue->count, slot = (slot + 1) % tetrominoQueueCapacity) {
+      TetrominoPixelArray pixels = queue->pixels + slot * tetrominoArrayMaxSize;
+      if (generator->type == functionTetrominoGenerator) {
+         NextTetromino nextTetromino;
+         nextTetromino.size = tetrominoMaxSize;
+         nextTetromino.pixels = pixels;
+         countGameStat(game, generatorCalls);
+         game->getNextTetromino(&nextTetromino);
+         queue->sizes[slot] = nextTetromino.size;
+      } else if (generator->type == logTetrominoGenerator) {
+         queue->sizes[slot] = readLoggedTetromino(generator, pixels);
+      } else {
+         unsigned kind = nextTetrominoKind(generator);
+         uint16_t mask = standardTetrominoMasks[kind];
+         for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+            pixels[i] = (mask >> i) & 1 ? (TetrominoPixel) (kind + 1) : 0;
+         }
+         queue->sizes[slot] = standardTetrominoSizes[kind];
+      }
+      ++queue->total;
+      countGameStat(game, generatedTetrominoes);
+   }
+   game->nextTetromino->size = queue->sizes[queue->head];
+   game->nextTetromino->pixels = queue->pixels + queue->head * tetrominoArrayMaxSize;
+}
+
+/*!
+ * \brief Удаляет первый элемент очереди следующих тетрамино.
+ * 
+ * #Game::nextTetromino начинает указывать на новый первый элемент. Если в
+ * очереди осталось меньше #tetrominoPreviewLength элементов, то она
+ * заполняется.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void advanceTetrominoQueue(Game* game) {
+   TetrominoQueue* queue = &game->tetrominoQueue;
+   queue->head = (queue->head + 1) % tetrominoQueueCapacity;
+   --queue->count;
+   game->dirtyRegion.nextTetrominoChanged = 1;
+   if (queue->count < tetrominoPreviewLength) {
+      refillTetrominoQueue(game);
+      return;
+   }
+   game->nextTetromino->size = queue->sizes[queue->head];
+   game->nextTetromino->pixels = queue->pixels + queue->head * tetrominoArrayMaxSize;
+}
+
+/*!
+ * \brief Есть ли в игре активное тетрамино, которое нужно показывать в
+ * игровом стакане.
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return
+ *          - 1) \a 0 если нет
+ *          - 2) \a 1 если есть
+ */
+static inline unsigned isActiveTetrominoShown(const Game* game) {
+   return game->status == playGameStatus || game->status == endPlayerLoose;
+}
+
+#ifdef TETRIS_ENGINE_GAME_VIEW
+/*!
+ * \brief Публикатор копий игры.
+ * 
+ * Двойной буфер, каждая половина которого защищена своим счетчиком
+ * последовательности (seqlock). Поток игры пишет новую копию в половину, в
+ * которой лежит не последняя публикация, поэтому читатель, копирующий
+ * последнюю публикацию, пересекается с записью, только если не успел за
+ * время двух публикаций. Тогда читатель повторяет копирование, а поток игры
+ * никого не ждет.
+ * 
+ * Половина состоит из атомарных 64-битных слов, которые пишутся и читаются
+ * без упорядочивания, чтобы одновременные запись и чтение не были гонкой
+ * данных. В начале половины лежит #GameView, затем с нового слова
+ * #Game::gameField.
+ */
+struct tagGameViewPublisher {
+   atomic_uint_fast64_t version;      ///< номер последней публикации. Она лежит в половине \a version % 2
+   atomic_uint_fast64_t sequences[2]; ///< счетчики половин. Нечетный - половина записывается
+   size_t fieldSize;                  ///< размер #Game::gameField в байтах
+   size_t slotWords;                  ///< количество слов в половине
+   _Atomic uint64_t* words;           ///< слова обеих половин подряд
+};
+
+/*!
+ * \brief Количество слов половины публикатора, которые занимает #GameView.
+ */
+#define gameViewHeaderWords ((sizeof(GameView) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+/*!
+ * \brief Записывает байты в атомарные слова.
+ * 
+ * \param[out] words слова
+ * \param[in] source байты
+ * \param[in] size количество байтов
+ */
+static void storeGameViewWords(_Atomic uint64_t* words, const void* source, size_t size) {
+   const uint8_t* bytes = (const uint8_t*) source;
+   for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t), ++words) {
+      uint64_t word;
+      memcpy(&word, bytes, sizeof(uint64_t));
+      atomic_store_explicit(words, word, memory_order_relaxed);
+   }
+   if (size) {
+      uint64_t word = 0;
+      memcpy(&word, bytes, size);
+      atomic_store_explicit(words, word, memory_order_relaxed);
+   }
+}
+
+/*!
+ * \brief Читает байты из атомарных слов.
+ * 
+ * \param[out] destination байты
+ * \param[in] words слова
+ * \param[in] size количество байтов
+ */
+static void loadGameViewWords(void* destination, const _Atomic uint64_t* words, size_t size) {
+   uint8_t* bytes = (uint8_t*) destination;
+   for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t), ++words) {
+      uint64_t word = atomic_load_explicit(words, memory_order_relaxed);
+      memcpy(bytes, &word, sizeof(uint64_t));
+   }
+   if (size) {
+      uint64_t word = atomic_load_explicit(words, memory_order_relaxed);
+      memcpy(bytes, &word, size);
+   }
+}
+
+/*!
+ * \brief Публикует текущее состояние игры.
+ * 
+ * \param[in] game указатель на структуру. #Game::viewPublisher не \a NULL
+ */
+static void writeGameView(const Game* game) {
+   GameViewPublisher* publisher = game->viewPublisher;
+   GameView view;
+   // обнуляются и байты выравнивания, чтобы копия не зависела от стека
+   memset(&view, 0, sizeof(GameView));
+   view.version = atomic_load_explicit(&publisher->version, memory_order_relaxed) + 1;
+   view.status = game->status;
+   view.score = game->score;
+   view.width = getGameWidth(game);
+   view.height = getGameHeight(game);
+   view.fieldMode = game->fieldMode;
+   if (isActiveTetrominoShown(game)) {
+      view.activeTetrominoSize = game->activeTetromino->size;
+      view.activeTetrominoX = game->activeTetromino->x;
+      view.activeTetrominoY = game->activeTetromino->y;
+      memcpy(view.activeTetrominoPixels, game->activeTetromino->pixels, tetrominoArrayMaxSize * sizeof(TetrominoPixel));
+   }
+   if (game->tetrominoQueue.count) {
+      view.nextTetrominoSize = game->nextTetromino->size;
+      memcpy(view.nextTetrominoPixels, game->nextTetromino->pixels, tetrominoArrayMaxSize * sizeof(TetrominoPixel));
+   }
+   unsigned slot = (unsigned) (view.version % 2);
+   uint64_t sequence = atomic_load_explicit(&publisher->sequences[slot], memory_order_relaxed);
+   atomic_store_explicit(&publisher->sequences[slot], sequence + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+   _Atomic uint64_t* words = publisher->words + slot * publisher->slotWords;
+   storeGameViewWords(words, &view, sizeof(GameView));
+   // в режиме #lockedGameFieldMode активное тетрамино дорисовывает читатель
+   storeGameViewWords(words + gameViewHeaderWords, game->gameField, publisher->fieldSize);
+   atomic_store_explicit(&publisher->sequences[slot], sequence + 2, memory_order_release);
+   atomic_store_explicit(&publisher->version, view.version, memory_order_release);
+}
+
+/*!
+ * \brief Публикует текущее состояние игры, если у нее есть публикатор.
+ * 
+ * Вызывается в конце каждой функции, изменившей игру.
+ * 
+ * \param[in] game указатель на структуру
+ */
+static inline void publishGameView(const Game* game) {
+   if (game->viewPublisher) {
+      writeGameView(game);
+   }
+}
+
+TETRIS_ENGINE_API GameViewPublisher* attachGameView(Game* game) {
+   if (game->viewPublisher) {
+      return game->viewPublisher;
+   }
+   size_t fieldSize = (size_t) getGameWidth(game) * getGameHeight(game) * sizeof(TetrominoPixel);
+   size_t slotWords = gameViewHeaderWords + alignMemoryBlock(fieldSize) / sizeof(uint64_t);
+   size_t wordsOffset = alignMemoryBlock(sizeof(GameViewPublisher));
+   uint8_t* block = (uint8_t*) malloc(wordsOffset + 2 * slotWords * sizeof(uint64_t));
+   if (!block) {
+      return NULL;
+   }
+   GameViewPublisher* publisher = (GameViewPublisher*) block;
+   atomic_init(&publisher->version, 0);
+   atomic_init(&publisher->sequences[0], 0);
+   atomic_init(&publisher->sequences[1], 0);
+   publisher->fieldSize = fieldSize;
+   publisher->slotWords = slotWords;
+   publisher->words = (_Atomic uint64_t*) (block + wordsOffset);
+   for (size_t i = 0; i < 2 * slotWords; ++i) {
+      atomic_init(&publisher->words[i], 0);
+   }
+   game->viewPublisher = publisher;
+   writeGameView(game);
+   return publisher;
+}
+
+TETRIS_ENGINE_API void readGameView(const GameViewPublisher* publisher, GameView* view, TetrominoPixel* field) {
+   for (;;) {
+      uint64_t version = atomic_load_explicit(&publisher->version, memory_order_acquire);
+      unsigned slot = (unsigned) (version % 2);
+      uint64_t sequence = atomic_load_explicit(&publisher->sequences[slot], memory_order_acquire);
+      if (sequence % 2) {
+         continue;
+      }
+      const _Atomic uint64_t* words = publisher->words + slot * publisher->slotWords;
+      loadGameViewWords(view, words, sizeof(GameView));
+      if (field) {
+         loadGameViewWords(field, words + gameViewHeaderWords, publisher->fieldSize);
+      }
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&publisher->sequences[slot], memory_order_relaxed) == sequence) {
+         break;
+      }
+   }
+   if (!field || view->fieldMode != lockedGameFieldMode) {
+      return;
+   }
+   for (int y = 0; y < view->activeTetrominoSize; ++y) {
+      int fieldY = view->activeTetrominoY + y;
+      if (fieldY < 0 || fieldY >= view->height) {
+         continue;
+      }
+      for (int x = 0; x < view->activeTetrominoSize; ++x) {
+         int fieldX = view->activeTetrominoX + x;
+         TetrominoPixel tetrominoPixel = flatArrayAs2D(view->activeTetrominoPixels, x, y, tetrominoMaxSize);
+         if (tetrominoPixel && fieldX >= 0 && fieldX < view->width) {
+            flatArrayAs2D(field, fieldX, fieldY, view->width) = tetrominoPixel;
+         }
+      }
+   }
+}
+
+TETRIS_ENGINE_API uint64_t getGameViewVersion(const GameViewPublisher* publisher) {
+   return atomic_load_explicit(&publisher->version, memory_order_acquire);
+}
+
+TETRIS_ENGINE_API void detachGameView(Game* game) {
+   free(game->viewPublisher);
+   game->viewPublisher = NULL;
+}
+#else
+/*!
+ * \brief Без TETRIS_ENGINE_GAME_VIEW публиковать некому: ничего не делает.
+ */
+#define publishGameView(game) ((void) 0)
+#endif
+
+/*!
+ * \brief Добавляет событие в конец #Game::eventQueue.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] type вид события
+ * 
+ * \return
+ *          - 1) \a NULL если очередь заполнена. Событие считается в
+ * #GameEventQueue::droppedEvents
+ *          - 2) событие, в котором заполнены только #GameEvent::type и
+ * #GameEvent::score
+ */
+static GameEvent* pushGameEvent(Game* game, GameEventType type) {
+   GameEventQueue* queue = &game->eventQueue;
+   if (queue->count == gameEventQueueCapacity) {
+      ++queue->droppedEvents;
+      return NULL;
+   }
+   GameEvent* event = queue->events + (queue->head + queue->count) % gameEventQueueCapacity;
+   ++queue->count;
+   memset(event, 0, sizeof(GameEvent));
+   event->type = type;
+   event->score = game->score;
+   return event;
+}
+
+/*!
+ * \brief Добавляет событие с положением активного тетрамино
+ * (#spawnGameEvent, #lockGameEvent).
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] type вид события
+ */
+static void pushActiveTetrominoEvent(Game* game, GameEventType type) {
+   GameEvent* event = pushGameEvent(game, type);
+   if (event) {
+      event->x = game->activeTetromino->x;
+      event->y = game->activeTetromino->y;
+      event->size = game->activeTetromino->size;
+      event->shape = game->activeTetromino->shape;
+      event->orientation = type == lockGameEvent ? game->activeTetromino->orientation : 0;
+   }
+}
+
+/*!
+ * \brief Добавляет #gameOverGameEvent с текущим #Game::status.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+static void pushGameOverEvent(Game* game) {
+   GameEvent* event = pushGameEvent(game, gameOverGameEvent);
+   if (event) {
+      event->status = game->status;
+   }
+}
+
+TETRIS_ENGINE_API unsigned drainGameEvents(Game* game, GameEvent* events, unsigned capacity) {
+   GameEventQueue* queue = &game->eventQueue;
+   unsigned count = queue->count < capacity ? queue->count : capacity;
+   for (unsigned i = 0; i < count; ++i) {
+      events[i] = queue->events[(queue->head + i) % gameEventQueueCapacity];
+   }
+   queue->head = (uint8_t) ((queue->head + count) % gameEventQueueCapacity);
+   queue->count = (uint8_t) (queue->count - count);
+   return count;
+}
+
+/*!
+ * \brief Сбрасывает очередь следующих тетрамино после смены генератора.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+static void resetTetrominoQueue(Game* game) {
+   game->tetrominoQueue.count = 0;
+   game->dirtyRegion.nextTetrominoChanged = 1;
+   if (game->status == playGameStatus) {
+      refillTetrominoQueue(game);
+   }
+   publishGameView(game);
+}
+
+TETRIS_ENGINE_API void setTetrominoGenerator(Game* game, TetrominoGeneratorType type, uint64_t seed) {
+   TetrominoGenerator* generator = &game->tetrominoGenerator;
+   generator->type = type;
+   generator->state = seed;
+   for (int kind = 0; kind < tetrominoKindCount; ++kind) {
+      generator->bag[kind] = (uint8_t) kind;
+   }
+   generator->bagPosition = tetrominoKindCount;
+   resetTetrominoQueue(game);
+}
+
+TETRIS_ENGINE_API void setTetrominoSequence(Game* game, const uint8_t* kinds, unsigned length) {
+   TetrominoGenerator* generator = &game->tetrominoGenerator;
+   generator->type = sequenceTetrominoGenerator;
+   generator->sequence = kinds;
+   generator->sequenceLength = length;
+   generator->sequencePosition = 0;
+   resetTetrominoQueue(game);
+}
+
+TETRIS_ENGINE_API const TetrominoPixel* getPreviewTetromino(const Game* game, unsigned index, int8_t* size) {
+   if (index >= tetrominoPreviewLength) {
+      return NULL;
+   }
+   unsigned slot = (game->tetrominoQueue.head + index) % tetrominoQueueCapacity;
+   if (size) {
+      *size = game->tetrominoQueue.sizes[slot];
+   }
+   return game->tetrominoQueue.pixels + slot * tetrominoArrayMaxSize;
+}
+
+TETRIS_ENGINE_API void startGame(Game* game) {
+   refillTetrominoQueue(game);
+   setActiveTetromino(game, game->nextTetromino, getGameWidth(game) / 2 - game->nextTetromino->size / 2);
+   advanceTetrominoQueue(game);
+   pushActiveTetrominoEvent(game, spawnGameEvent);
+   game->status = playGameStatus;
+   game->dirtyRegion.statusChanged = 1;
+   publishGameView(game);
+}
+
+TETRIS_ENGINE_API TetrominoPixel getGameFieldPixel(Game* game, GameCoordinate x, GameCoordinate y) {
+   countGameStat(game, fieldPixelReads);
+   if (x < 0 || x >= getGameWidth(game)) {
+      return 1;
+   }
+   if (y < 0) {
+      return 1;
+   }
+   if (y >= getGameHeight(game)) {
+      return 0;
+   }
+   return flatArrayAs2D(game->gameField, x, y, getGameWidth(game));
+}
+
+/*!
+ * \brief Устанавливает пиксел в игровом стакане.
+ * 
+ * \note Если пиксел находится вовне игрового стакана, то ничего не установит.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] pixel пиксел
+ * \param[in] x x-координата пиксела
+ * \param[in] y y-координата пиксела
+ */
+TETRIS_ENGINE_API void setPixel(Game* game, TetrominoPixel pixel, GameCoordinate x, GameCoordinate y) {
+   if (x < 0 || x >= getGameWidth(game)) {
+      return;
+   }
+   if (y < 0) {
+      return;
+   }
+   if (y >= getGameHeight(game)) {
+      return;
+   }
+   flatArrayAs2D(game->gameField, x, y, getGameWidth(game)) = pixel;
+}
+
+/*!
+ * \brief Может ли активное тетрамино подвинутся вниз?
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return  
+ *          - 1) \a 0 если не может
+ *          - 2) \a 1 если может
+ */
+TETRIS_ENGINE_API unsigned canActiveTetrominoMoveDown(Game* game) {
+   return !isMaskColliding(game, game->activeTetromino->masks[game->activeTetromino->orientation],
+         game->activeTetromino->x, game->activeTetromino->y - 1);
+}
+
+/*!
+ * \brief Может ли активное тетрамино повернутся по часовой стрелке?
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return  
+ *          - 1) \a 0 если не может
+ *          - 2) \a 1 если может
+ */
+TETRIS_ENGINE_API unsigned canActiveTetrominoRotateClockwise(Game* game) {
+   return !isMaskColliding(game, game->activeTetromino->clockwiseSweepMasks[game->activeTetromino->orientation],
+         game->activeTetromino->x, game->activeTetromino->y);
+}
+
+/*!
+ * \brief Может ли активное тетрамино повернутся против часовой стрелки?
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return  
+ *          - 1) \a 0 если не может
+ *          - 2) \a 1 если может
+ */
+TETRIS_ENGINE_API unsigned canActiveTetrominoRotateAgainstClockwise(Game* game) {
+   return !isMaskColliding(game, game->activeTetromino->againstClockwiseSweepMasks[game->activeTetromino->orientation],
+         game->activeTetromino->x, game->activeTetromino->y);
+}
+
+/*!
+ * \brief Рисует активное тетрамино в массиве размером с игровой стакан или
+ * стирает его оттуда.
+ * 
+ * Пикселы вне игрового стакана пропускаются.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in,out] field массив длиной #Game::width * #Game::height
+ * \param[in] erase если не \a 0, то пикселы тетрамино обнуляются
+ */
+static void drawActiveTetromino(const Game* game, TetrominoPixel* field, unsigned erase) {
+   const ActiveTetromino* activeTetromino = game->activeTetromino;
+   for (int y = 0; y < activeTetromino->size; ++y) {
+      int fieldY = activeTetromino->y + y;
+      if (fieldY < 0 || fieldY >= getGameHeight(game)) {
+         continue;
+      }
+      for (int x = 0; x < activeTetromino->size; ++x) {
+         int fieldX = activeTetromino->x + x;
+         TetrominoPixel tetrominoPixel = flatArrayAs2D(activeTetromino->pixels, x, y, tetrominoMaxSize);
+         if (tetrominoPixel && fieldX >= 0 && fieldX < getGameWidth(game)) {
+            flatArrayAs2D(field, fieldX, fieldY, getGameWidth(game)) = erase ? 0 : tetrominoPixel;
+         }
+      }
+   }
+}
+
+/*!
+ * \brief Отмечает строки игрового стакана [\a fromY .. \a toY) как
+ * измененные.
+ * 
+ * Строки вне игрового стакана пропускаются.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in,out] region изменения
+ * \param[in] fromY y-координата нижней строки
+ * \param[in] toY y-координата над верхней строкой
+ */
+static void markDirtyRows(const Game* game, DirtyRegion* region, int fromY, int toY) {
+   if (fromY < 0) {
+      fromY = 0;
+   }
+   if (toY > getGameHeight(game)) {
+      toY = getGameHeight(game);
+   }
+   for (int y = fromY; y < toY; ++y) {
+      region->rows[y / 64] |= (uint64_t) 1 << (y % 64);
+   }
+}
+
+/*!
+ * \brief Отмечает всю игру как измененную.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+static void markGameDirty(Game* game) {
+   markDirtyRows(game, &game->dirtyRegion, 0, getGameHeight(game));
+   game->dirtyRegion.nextTetrominoChanged = 1;
+   game->dirtyRegion.scoreChanged = 1;
+   game->dirtyRegion.statusChanged = 1;
+}
+
+/*!
+ * \brief Вычисляет прямоугольник, который занимают пикселы активного
+ * тетрамино.
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return прямоугольник. Если активное тетрамино не показывается, то
+ * его ширина равна \a 0
+ */
+static TetrominoRect getActiveTetrominoRect(const Game* game) {
+   TetrominoRect rect = {0, 0, 0, 0};
+   const ActiveTetromino* activeTetromino = game->activeTetromino;
+   if (!isActiveTetrominoShown(game)) {
+      return rect;
+   }
+   TetrominoBounds bounds = getActiveTetrominoBounds(game);
+   if (!bounds.width) {
+      return rect;
+   }
+   rect.x = (GameCoordinate) (activeTetromino->x + bounds.x);
+   rect.y = (GameCoordinate) (activeTetromino->y + bounds.y);
+   rect.width = bounds.width;
+   rect.height = bounds.height;
+   return rect;
+}
+
+TETRIS_ENGINE_API void getDirtyRegion(Game* game, DirtyRegion* region, uint64_t* rows) {
+   DirtyRegion* accumulated = &game->dirtyRegion;
+   size_t rowWords = dirtyRowWords(getGameHeight(game));
+   *region = *accumulated;
+   region->rows = rows;
+   memcpy(rows, accumulated->rows, rowWords * sizeof(uint64_t));
+   region->newActiveTetromino = getActiveTetrominoRect(game);
+   markDirtyRows(game, region, region->oldActiveTetromino.y,
+         region->oldActiveTetromino.y + region->oldActiveTetromino.height);
+   markDirtyRows(game, region, region->newActiveTetromino.y,
+         region->newActiveTetromino.y + region->newActiveTetromino.height);
+   memset(accumulated->rows, 0, rowWords * sizeof(uint64_t));
+   accumulated->oldActiveTetromino = region->newActiveTetromino;
+   accumulated->nextTetrominoChanged = 0;
+   accumulated->scoreChanged = 0;
+   accumulated->statusChanged = 0;
+}
+
+/*!
+ * \brief Заносит информацию об активном тетрамино в игровой стакан.
+ * 
+ * В режиме #lockedGameFieldMode ничего не делает.
+ * 
+ * \warning Каких-либо проверок не производит.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void pushActiveTetrominoInfo(Game* game) {
+   if (game->fieldMode == compositeGameFieldMode) {
+      drawActiveTetromino(game, game->gameField, 0);
+   }
+}
+
+/*!
+ * \brief Удаляет информацию об активном тетрамино из игрового стакана.
+ * 
+ * В режиме #lockedGameFieldMode ничего не делает.
+ * 
+ * \warning Каких-либо проверок не производит.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void popActiveTetrominoInfo(Game* game) {
+   if (game->fieldMode == compositeGameFieldMode) {
+      drawActiveTetromino(game, game->gameField, 1);
+   }
+}
+
+/*!
+ * \brief Приводит игровой стакан, записанный в другом режиме, к режиму игры.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] fieldMode режим, в котором записан #Game::gameField
+ */
+static void convertGameField(Game* game, GameFieldMode fieldMode) {
+   if (fieldMode != game->fieldMode && isActiveTetrominoShown(game)) {
+      drawActiveTetromino(game, game->gameField, game->fieldMode == lockedGameFieldMode);
+   }
+}
+
+TETRIS_ENGINE_API void setGameFieldMode(Game* game, GameFieldMode mode) {
+   GameFieldMode fieldMode = game->fieldMode;
+   *(GameFieldMode*) &game->fieldMode = mode;
+   convertGameField(game, fieldMode);
+   publishGameView(game);
+}
+
+TETRIS_ENGINE_API void renderField(const Game* game, TetrominoPixel* out) {
+   memcpy(out, game->gameField, (size_t) getGameWidth(game) * getGameHeight(game) * sizeof(TetrominoPixel));
+   if (game->fieldMode == lockedGameFieldMode && isActiveTetrominoShown(game)) {
+      drawActiveTetromino(game, out, 0);
+   }
+}
+
+/*!
+ * \brief Если это возможно, двигает активное тетрамино вниз на одну строчку.
+ *
+ * \note На момент вызова функции информация об активном тетрамино должна быть
+ * в игровом стакане. После работы функции и при удаче, и при неудаче
+ * информация об активном тетрамино будет в игровом стакане.
+ * 
+ * \param[in,out] game указатель на структуру
+ * 
+ * \return  
+ *          - 1) \a 0 если не может
+ *          - 2) \a 1 если может
+ */
+TETRIS_ENGINE_API unsigned moveActiveTetrominoDown(Game* game) {
+   if (canActiveTetrominoMoveDown(game)) {
+      popActiveTetrominoInfo(game);
+      --game->activeTetromino->y;
+      pushActiveTetrominoInfo(game);
+      return 1;
+   } else {
+      return 0;
+   }
+}
+
+TETRIS_ENGINE_API unsigned rotateClockwise(Game* game) {
+   countGameStat(game, inputCalls[rotateClockwiseInput]);
+   if (canActiveTetrominoRotateClockwise(game)) {
+      ActiveTetromino* activeTetromino = game->activeTetromino;
+      popActiveTetrominoInfo(game);
+      activeTetromino->orientation = (activeTetromino->orientation + 1) % tetrominoOrientationCount;
+      activeTetromino->pixels = activeTetromino->orientationPixels + activeTetromino->orientation * tetrominoArrayMaxSize;
+      pushActiveTetrominoInfo(game);
+      publishGameView(game);
+      return 0;
+   } else {
+      countGameStat(game, inputFailures[rotateClockwiseInput]);
+      return 1;
+   }
+}
+
+TETRIS_ENGINE_API unsigned rotateAgainstClockwise(Game* game) {
+   countGameStat(game, inputCalls[rotateAgainstClockwiseInput]);
+   if (canActiveTetrominoRotateAgainstClockwise(game)) {
+      ActiveTetromino* activeTetromino = game->activeTetromino;
+      popActiveTetrominoInfo(game);
+      activeTetromino->orientation = (activeTetromino->orientation + tetrominoOrientationCount - 1) % tetrominoOrientationCount;
+      activeTetromino->pixels = activeTetromino->orientationPixels + activeTetromino->orientation * tetrominoArrayMaxSize;
+      pushActiveTetrominoInfo(game);
+      publishGameView(game);
+      return 0;
+   } else {
+      countGameStat(game, inputFailures[rotateAgainstClockwiseInput]);
+      return 1;
+   }
+}
+
+/*!
+ * \brief Высота, которой считаются стены при вычислении #BoardFeatures.
+ * 
+ * Больше высоты любого столбца.
+ */
+#define wallColumnHeight (gameCoordinateMax + 1)
+
+/*!
+ * \brief Возвращает высоту столбца или #wallColumnHeight, если столбца нет.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in] x x-координата столбца. Может быть вне игрового стакана
+ * 
+ * \return высота
+ */
+static inline int getColumnHeightOrWall(const Game* game, int x) {
+   return x < 0 || x >= getGameWidth(game) ? wallColumnHeight : game->columnHeights[x];
+}
+
+/*!
+ * \brief Возвращает глубину колодца столбца (см. #BoardFeatures::wellDepths).
+ * 
+ * \param[in] left высота левого соседа
+ * \param[in] height высота столбца
+ * \param[in] right высота правого соседа
+ * 
+ * \return глубина
+ */
+static inline int getWellDepth(int left, int height, int right) {
+   int depth = (left < right ? left : right) - height;
+   return depth > 0 ? depth : 0;
+}
+
+/*!
+ * \brief Добавляет столбец к признакам #BoardFeatures, зависящим от высот
+ * столбцов.
+ * 
+ * Столбцы добавляются слева направо. Пара с правым соседом входит в
+ * #BoardFeatures::bumpiness здесь.
+ * 
+ * \param[in,out] features признаки
+ * \param[in] left высота левого соседа или #wallColumnHeight
+ * \param[in] height высота столбца
+ * \param[in] right высота правого соседа или #wallColumnHeight
+ */
+static inline void addColumnFeatures(BoardFeatures* features, int left, int height, int right) {
+   features->aggregateHeight += height;
+   if (height > features->maxHeight) {
+      features->maxHeight = (GameCoordinate) height;
+   }
+   if (right != wallColumnHeight) {
+      features->bumpiness += abs(height - right);
+   }
+   features->wellDepths += getWellDepth(left, height, right);
+}
+
+/*!
+ * \brief Обнуляет признаки #BoardFeatures, зависящие от высот столбцов.
+ * 
+ * \param[out] features признаки
+ */
+static inline void clearColumnFeatures(BoardFeatures* features) {
+   features->aggregateHeight = 0;
+   features->maxHeight = 0;
+   features->bumpiness = 0;
+   features->wellDepths = 0;
+}
+
+/*!
+ * \brief Возвращает количество установленных бит маски.
+ * 
+ * \param[in] mask маска
+ * 
+ * \return количество бит
+ */
+static inline int countMaskBits(unsigned mask) {
+   int count = 0;
+   for (; mask; mask &= mask - 1) {
+      ++count;
+   }
+   return count;
+}
+
+/*!
+ * \brief Перемешивает биты числа (финализатор SplitMix64).
+ * 
+ * Взаимно однозначна, переводит \a 0 в \a 0.
+ * 
+ * \param[in] value число
+ * 
+ * \return перемешанное число
+ */
+static inline uint64_t mixGameHash(uint64_t value) {
+   value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+   value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+   return value ^ (value >> 31);
+}
+
+/*!
+ * \brief Возвращает ключ Зобриста зафиксированного пиксела.
+ * 
+ * Ключи вычисляются, а не хранятся в таблице, поэтому не занимают памяти
+ * игры и одинаковы во всех процессах.
+ * 
+ * \param[in] x x-координата пиксела
+ * \param[in] pixel пиксел. Не \a 0
+ * 
+ * \return ключ
+ */
+static inline uint64_t getPixelHashKey(int x, TetrominoPixel pixel) {
+   return mixGameHash((uint64_t) (uint32_t) x << 8 | pixel);
+}
+
+/*!
+ * \brief Возвращает вклад строки \a y в #Game::boardHash.
+ * 
+ * \param[in] rowHash хеш строки (#Game::rowHashes)
+ * \param[in] y y-координата строки
+ * 
+ * \return вклад. Для пустой строки \a 0
+ */
+static inline uint64_t getRowHashContribution(uint64_t rowHash, int y) {
+   return rowHash ? mixGameHash(rowHash + ((uint64_t) y + 1) * 0x9E3779B97F4A7C15ull) : 0;
+}
+
+/*!
+ * \brief Очищает полностью занятые строки.
+ * 
+ * Заполненными могут быть только строки, которые занимает только что
+ * зафиксированное тетрамино, поэтому проверяются только они (по
+ * #Game::rowFillCounts). Остальные строки сдвигаются вниз за один проход:
+ * каждая оставшаяся строка копируется не более одного раза.
+ * 
+ * \warning Должна вызываться сразу после #lockActiveTetromino.
+ * 
+ * \param game[in,out] указатель на структуру
+ * 
+ * \return кол-во очищенный строк
+ */
+TETRIS_ENGINE_API int8_t cleanLines(Game* game) {
+   int firstRow = game->activeTetromino->y < 0 ? 0 : game->activeTetromino->y;
+   int lastRow = game->activeTetromino->y + tetrominoMaxSize;
+   if (lastRow > getGameHeight(game)) {
+      lastRow = getGameHeight(game);
+   }
+   countGameStat(game, cleanLinesCalls);
+   addGameStat(game, scannedRows, lastRow - firstRow);
+   unsigned fullRows = 0;
+   for (int y = firstRow; y < lastRow; ++y) {
+      if (game->rowFillCounts[y] == getGameWidth(game)) {
+         fullRows |= 1u << (y - firstRow);
+      }
+   }
+   if (!fullRows) {
+      return 0;
+   }
+   // строки выше самого высокого столбца пусты, их двигать не нужно
+   int stackHeight = 0;
+   for (int x = 0; x < getGameWidth(game); ++x) {
+      if (game->columnHeights[x] > stackHeight) {
+         stackHeight = game->columnHeights[x];
+      }
+   }
+   int8_t cleanedLines = 0;
+   int targetY = firstRow;
+   for (int sourceY = firstRow; sourceY < stackHeight; ++sourceY) {
+      if (sourceY < lastRow && (fullRows & (1u << (sourceY - firstRow)))) {
+         if (!cleanedLines) {
+            // все строки от нижней очищенной до вершины стека меняются
+            markDirtyRows(game, &game->dirtyRegion, sourceY, stackHeight);
+         }
+         ++cleanedLines;
+         game->boardHash ^= getRowHashContribution(game->rowHashes[sourceY], sourceY);
+         continue;
+      }
+      if (targetY != sourceY) {
+         countGameStat(game, movedRows);
+         game->boardHash ^= getRowHashContribution(game->rowHashes[sourceY], sourceY)
+               ^ getRowHashContribution(game->rowHashes[sourceY], targetY);
+         game->rowHashes[targetY] = game->rowHashes[sourceY];
+         memcpy(&flatArrayAs2D(game->gameField, 0, targetY, getGameWidth(game)),
+               &flatArrayAs2D(game->gameField, 0, sourceY, getGameWidth(game)),
+               sizeof(TetrominoPixel) * getGameWidth(game));
+         memcpy(getOccupancyRow(game, targetY), getOccupancyRow(game, sourceY),
+               getGameOccupancyRowWords(game) * sizeof(uint64_t));
+         game->rowFillCounts[targetY] = game->rowFillCounts[sourceY];
+      }
+      ++targetY;
+   }
+   // освободившиеся строки сверху заполнить нулями, в битовой доске они
+   // содержат только стены
+   for (; targetY < stackHeight; ++targetY) {
+      memset(&flatArrayAs2D(game->gameField, 0, targetY, getGameWidth(game)), 0, sizeof(TetrominoPixel) * getGameWidth(game));
+      memcpy(getOccupancyRow(game, targetY), getOccupancyRow(game, getGameHeight(game)),
+            getGameOccupancyRowWords(game) * sizeof(uint64_t));
+      game->rowFillCounts[targetY] = 0;
+      game->rowHashes[targetY] = 0;
+   }
+   // каждая очищенная строка была ниже вершины любого столбца
+   for (int x = 0; x < getGameWidth(game); ++x) {
+      int columnHeight = game->columnHeights[x] - cleanedLines;
+      while (columnHeight > 0 && !(getOccupancyWindow(game, x, columnHeight - 1) & 1)) {
+         --columnHeight;
+      }
+      game->columnHeights[x] = columnHeight;
+   }
+   BoardFeatures* features = &game->boardFeatures;
+   features->lockedPixels -= (uint32_t) cleanedLines * getGameWidth(game);
+   // очищенные строки были заполнены, а добавленные сверху пусты
+   features->rowTransitions += 2 * (uint32_t) cleanedLines;
+   clearColumnFeatures(features);
+   for (int x = 0; x < getGameWidth(game); ++x) {
+      addColumnFeatures(features, getColumnHeightOrWall(game, x - 1), game->columnHeights[x],
+            getColumnHeightOrWall(game, x + 1));
+   }
+   features->holes = features->aggregateHeight - features->lockedPixels;
+   addGameStat(game, clearedRows, cleanedLines);
+   GameEvent* event = pushGameEvent(game, lineClearGameEvent);
+   if (event) {
+      // fullRows отсчитывается от firstRow, событие - от нижней очищенной
+      // строки
+      int lowestRow = firstRow;
+      for (; !(fullRows & 1); fullRows >>= 1) {
+         ++lowestRow;
+      }
+      event->y = (GameCoordinate) lowestRow;
+      event->clearedRows = cleanedLines;
+      event->clearedRowMask = (uint8_t) fullRows;
+   }
+   return cleanedLines;
+}
+
+/*!
+ * \brief Количество установленных бит в каждом из 16 значений маски строки
+ * тетрамино.
+ */
+static const int8_t nibblePopCount[1 << tetrominoMaxSize] = {
+   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+/*!
+ * \brief Возвращает количество смен занятости между соседними пикселами
+ * маски из #tetrominoMaxSize + 2 пикселов строки.
+ * 
+ * \param[in] bits маска
+ * 
+ * \return количество смен
+ */
+static inline int countRowTransitions(unsigned bits) {
+   return countMaskBits((bits ^ (bits >> 1)) & ((1u << (tetrominoMaxSize + 1)) - 1));
+}
+
+/*!
+ * \brief Вычисляет #BoardFeatures после фиксации маски тетрамино в \a x:y
+ * без очистки строк.
+ * 
+ * Фиксация меняет высоты только столбцов маски, поэтому пересчитываются
+ * только они и их соседи, а #BoardFeatures::rowTransitions - только в
+ * строках маски рядом с ней.
+ * 
+ * \warning Маска должна помещаться в игровой стакан и не пересекаться с
+ * занятыми пикселами.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in] mask маска тетрамино (см. #ActiveTetromino::masks)
+ * \param[in] x x-координата начала координат маски
+ * \param[in] y y-координата начала координат маски
+ * \param[out] features признаки после фиксации. Может совпадать с
+ * #Game::boardFeatures
+ * \param[out] maskHeights высоты столбцов [\a x .. \a x + #tetrominoMaxSize)
+ * после фиксации (#wallColumnHeight для столбцов вне стакана). Может быть
+ * \a NULL
+ */
+static void addTetrominoFeatures(const Game* game, unsigned mask, int x, int y, BoardFeatures* features,
+      int* maskHeights) {
+   // элемент i соответствует столбцу x - 2 + i: столбцы маски и по два
+   // соседа с каждой стороны для колодцев
+   int oldHeights[tetrominoMaxSize + 4];
+   int heights[tetrominoMaxSize + 4];
+   for (int i = 0; i < tetrominoMaxSize + 4; ++i) {
+      oldHeights[i] = heights[i] = getColumnHeightOrWall(game, x - 2 + i);
+   }
+   *features = game->boardFeatures;
+   for (int row = y; mask; mask >>= tetrominoMaxSize, ++row) {
+      unsigned rowMask = mask & ((1u << tetrominoMaxSize) - 1);
+      if (!rowMask) {
+         continue;
+      }
+      unsigned bits = getOccupancyBits(game, x - 1, row, tetrominoMaxSize + 2);
+      features->rowTransitions += countRowTransitions(bits | rowMask << 1) - countRowTransitions(bits);
+      features->lockedPixels += nibblePopCount[rowMask];
+      for (int i = 2; rowMask; rowMask >>= 1, ++i) {
+         if ((rowMask & 1) && heights[i] <= row) {
+            heights[i] = row + 1;
+         }
+      }
+   }
+   for (int i = 2; i < tetrominoMaxSize + 2; ++i) {
+      if (heights[i] != oldHeights[i]) {
+         features->aggregateHeight += heights[i] - oldHeights[i];
+         if (heights[i] > features->maxHeight) {
+            features->maxHeight = (GameCoordinate) heights[i];
+         }
+      }
+   }
+   for (int i = 1; i < tetrominoMaxSize + 3; ++i) {
+      if (heights[i] == wallColumnHeight) {
+         continue;
+      }
+      features->wellDepths += getWellDepth(heights[i - 1], heights[i], heights[i + 1])
+            - getWellDepth(oldHeights[i - 1], oldHeights[i], oldHeights[i + 1]);
+      if (heights[i + 1] != wallColumnHeight) {
+         features->bumpiness += abs(heights[i] - heights[i + 1]) - abs(oldHeights[i] - oldHeights[i + 1]);
+      }
+   }
+   features->holes = features->aggregateHeight - features->lockedPixels;
+   if (maskHeights) {
+      memcpy(maskHeights, heights + 2, tetrominoMaxSize * sizeof(int));
+   }
+}
+
+/*!
+ * \brief Фиксирует активное тетрамино: заносит его пикселы в битовую доску
+ * и хеши строк, а в режиме #lockedGameFieldMode и в игровой стакан.
+ * 
+ * \warning Каких-либо проверок не производит.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+TETRIS_ENGINE_API void lockActiveTetromino(Game* game) {
+   ActiveTetromino* activeTetromino = game->activeTetromino;
+   countGameStat(game, lockedTetrominoes);
+   pushActiveTetrominoEvent(game, lockGameEvent);
+   if (game->fieldMode == lockedGameFieldMode) {
+      drawActiveTetromino(game, game->gameField, 0);
+   }
+   unsigned mask = activeTetromino->masks[activeTetromino->orientation];
+   addTetrominoFeatures(game, mask, activeTetromino->x, activeTetromino->y, &game->boardFeatures, NULL);
+   for (int y = activeTetromino->y; mask; mask >>= tetrominoMaxSize, ++y) {
+      unsigned rowMask = mask & ((1u << tetrominoMaxSize) - 1);
+      if (!rowMask) {
+         continue;
+      }
+      setOccupancyWindow(game, rowMask, activeTetromino->x, y);
+      markDirtyRows(game, &game->dirtyRegion, y, y + 1);
+      game->rowFillCounts[y] += nibblePopCount[rowMask];
+      uint64_t rowHash = game->rowHashes[y];
+      for (int x = 0; rowMask; rowMask >>= 1, ++x) {
+         if (!(rowMask & 1)) {
+            continue;
+         }
+         rowHash ^= getPixelHashKey(activeTetromino->x + x,
+               flatArrayAs2D(activeTetromino->pixels, x, y - activeTetromino->y, tetrominoMaxSize));
+         if (game->columnHeights[activeTetromino->x + x] <= y) {
+            game->columnHeights[activeTetromino->x + x] = y + 1;
+         }
+      }
+      game->boardHash ^= getRowHashContribution(game->rowHashes[y], y) ^ getRowHashContribution(rowHash, y);
+      game->rowHashes[y] = rowHash;
+   }
+}
+
+/*!
+ * \brief Находится ли активное тетрамино полностью в игровом стакане.
+ * 
+ * Проверяет только на нахождение прямо сверху от игрового стакана.
+ * 
+ * \param game[in] указатель на структуру
+ * 
+ * \return  
+ *          - 1) \a 0 если как минимум часть тетрамино находится во вне 
+ * игрового стакана
+ *          - 2) \a 1 если тетрамино полностью находится в игровом стакане
+ */
+TETRIS_ENGINE_API unsigned isActiveTetrominoInGameBoard(Game* game) {
+   for (int8_t y = game->activeTetromino->size - 1; y >= 0; --y) {
+      for (int8_t x = 0; x < game->activeTetromino->size; ++x) {
+         if (flatArrayAs2D(game->activeTetromino->pixels, x, y, tetrominoMaxSize)) {
+            if (game->activeTetromino->y + y >= getGameHeight(game)) {
+               return 0;
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+/*!
+ * \brief Обрабатывает приземление активного тетрамино, которое не может
+ * подвинуться вниз.
+ * 
+ * Фиксирует активное тетрамино, очищает заполненные строки, начисляет очки и
+ * делает следующее тетрамино активным. Если достигнут максимум очков или игрок
+ * проиграл выставляет соответствующие статусы в #Game::status.
+ * 
+ * \param[in,out] game указатель на структуру
+ * 
+ * \return
+ *          - 1) \a 1 если тетрамино зафиксировано и игра продолжается
+ *          - 2) \a 2 если достигнут максимум очков
+ *          - 3) \a 3 если игрок проиграл
+ */
+TETRIS_ENGINE_API unsigned landActiveTetromino(Game* game) {
+   if(!isActiveTetrominoInGameBoard(game)) {
+      game->status = endPlayerLoose;
+      game->dirtyRegion.statusChanged = 1;
+      pushGameOverEvent(game);
+      return 3;
+   }
+   lockActiveTetromino(game);
+   startGameStatTimer(cleanLinesStart);
+   int8_t cleanedLines = cleanLines(game);
+   stopGameStatTimer(game, cleanLinesNanoseconds, cleanLinesStart);
+   uint32_t scoredAddend = game->getScoreAddend(cleanedLines);
+   uint32_t scoreCopy = game->score;
+   scoreCopy += scoredAddend;
+   if (scoreCopy < game->score || scoreCopy > game->maxScore) {
+      game->dirtyRegion.scoreChanged |= game->score != game->maxScore;
+      game->score = game->maxScore;
+      game->status = endMaxScoreStatus;
+      game->dirtyRegion.statusChanged = 1;
+      pushGameOverEvent(game);
+      return 2;
+   }
+   game->dirtyRegion.scoreChanged |= scoreCopy != game->score;
+   game->score = scoreCopy;
+   // nextTetromino -> activeTetromino, init nextTetromino
+   setActiveTetromino(game, game->nextTetromino, getGameWidth(game) / 2 - tetrominoMaxSize / 2);
+   advanceTetrominoQueue(game);
+   pushActiveTetrominoEvent(game, spawnGameEvent);
+   return 1;
+}
+
+/*!
+ * \brief Находится ли нижняя строка активного тетрамино выше самого
+ * высокого столбца (#BoardFeatures::maxHeight) больше чем на одну строку.
+ * 
+ * Тогда строка под тетрамино пуста во всем стакане и тетрамино может
+ * упасть на строку без проверки коллизий. Стоит O(1).
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return
+ *          - 1) \a 0 если тетрамино может задеть стек
+ *          - 2) \a 1 если тетрамино выше стека
+ */
+static inline unsigned isActiveTetrominoAboveStack(const Game* game) {
+   return game->activeTetromino->y + getActiveTetrominoBounds(game).y > game->boardFeatures.maxHeight;
+}
+
+TETRIS_ENGINE_API unsigned tick(Game* game) {
+   countGameStat(game, inputCalls[tickInput]);
+   unsigned result = 0;
+   if (isActiveTetrominoAboveStack(game)) {
+      // в режиме lockedGameFieldMode pop и push ничего не делают
+      countGameStat(game, skylineTicks);
+      popActiveTetrominoInfo(game);
+      --game->activeTetromino->y;
+      pushActiveTetrominoInfo(game);
+   } else if (!moveActiveTetrominoDown(game)) {
+      countGameStat(game, inputFailures[tickInput]);
+      result = landActiveTetromino(game);
+   }
+   publishGameView(game);
+   return result;
+}
+
+/*!
+ * \brief Вычисляет, на сколько строк активное тетрамино может упасть вниз.
+ * 
+ * Если все пикселы тетрамино находятся выше вершин своих столбцов
+ * (#Game::columnHeights), то расстояние вычисляется только по вершинам
+ * столбцов. Иначе (тетрамино под навесом) строки проверяются по одной.
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return количество строк
+ */
+TETRIS_ENGINE_API int getDropDistance(Game* game) {
+   ActiveTetromino* activeTetromino = game->activeTetromino;
+   const int8_t* columnBottoms = activeTetromino->columnBottoms[activeTetromino->orientation];
+   int dropDistance = activeTetromino->y + tetrominoMaxSize;
+   for (int x = 0; x < tetrominoMaxSize; ++x) {
+      if (columnBottoms[x] >= 0) {
+         int distance = activeTetromino->y + columnBottoms[x] - game->columnHeights[activeTetromino->x + x];
+         if (distance < 0) {
+            unsigned mask = activeTetromino->masks[activeTetromino->orientation];
+            dropDistance = 0;
+            while (!isMaskColliding(game, mask, activeTetromino->x, activeTetromino->y - dropDistance - 1)) {
+               ++dropDistance;
+            }
+            return dropDistance;
+         }
+         if (distance < dropDistance) {
+            dropDistance = distance;
+         }
+      }
+   }
+   return dropDistance;
+}
+
+TETRIS_ENGINE_API unsigned hardDrop(Game* game, GameCoordinate* droppedRows) {
+   countGameStat(game, inputCalls[hardDropInput]);
+   countGameStat(game, inputFailures[hardDropInput]);
+   int dropDistance = getDropDistance(game);
+   if (dropDistance) {
+      popActiveTetrominoInfo(game);
+      game->activeTetromino->y -= dropDistance;
+      pushActiveTetrominoInfo(game);
+   }
+   if (droppedRows) {
+      *droppedRows = dropDistance;
+   }
+   unsigned result = landActiveTetromino(game);
+   publishGameView(game);
+   return result;
+}
+
+TETRIS_ENGINE_API unsigned softDrop(Game* game, GameCoordinate rows, GameCoordinate* droppedRows) {
+   countGameStat(game, inputCalls[softDropInput]);
+   int dropDistance = getDropDistance(game);
+   if (rows < 0) {
+      rows = 0;
+   }
+   if (dropDistance > rows) {
+      dropDistance = rows;
+   }
+   if (dropDistance) {
+      popActiveTetrominoInfo(game);
+      game->activeTetromino->y -= dropDistance;
+      pushActiveTetrominoInfo(game);
+      publishGameView(game);
+   }
+   if (droppedRows) {
+      *droppedRows = dropDistance;
+   }
+   if (dropDistance < rows) {
+      countGameStat(game, inputFailures[softDropInput]);
+      return 1;
+   }
+   return 0;
+}
+
+TETRIS_ENGINE_API unsigned placeActiveTetromino(Game* game, const Placement* placement) {
+   popActiveTetrominoInfo(game);
+   game->activeTetromino->x = placement->x;
+   game->activeTetromino->y = placement->y;
+   game->activeTetromino->orientation = placement->orientation;
+   game->activeTetromino->pixels = game->activeTetromino->orientationPixels + placement->orientation * tetrominoArrayMaxSize;
+   pushActiveTetrominoInfo(game);
+   unsigned result = landActiveTetromino(game);
+   publishGameView(game);
+   return result;
+}
+
+/*!
+ * \brief Вычисляет высоту столбца после фиксации маски тетрамино и очистки
+ * заполненных строк.
+ * 
+ * Каждая очищенная строка ниже вершины любого столбца, поэтому столбец
+ * обычно просто опускается на количество очищенных строк. Только если
+ * вершина столбца лежит в очищенной строке, столбец просматривается вниз до
+ * ближайшего занятого пиксела.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in] mask маска тетрамино (см. #ActiveTetromino::masks)
+ * \param[in] maskX x-координата начала координат маски
+ * \param[in] maskY y-координата начала координат маски
+ * \param[in] maskHeights высоты столбцов маски после фиксации
+ * \param[in] fullRows маска очищаемых строк: бит \a i соответствует
+ * строке \a maskY + \a i
+ * \param[in] x x-координата столбца
+ * 
+ * \return высота столбца
+ */
+static int getClearedColumnHeight(const Game* game, unsigned mask, int maskX, int maskY, const int* maskHeights,
+      unsigned fullRows, int x) {
+   int maskColumn = x - maskX;
+   unsigned isMaskColumn = maskColumn >= 0 && maskColumn < tetrominoMaxSize;
+   int height = isMaskColumn ? maskHeights[maskColumn] : game->columnHeights[x];
+   int topRow = height - 1 - maskY;
+   if (topRow < 0 || topRow >= tetrominoMaxSize || !(fullRows & (1u << topRow))) {
+      return height - countMaskBits(fullRows);
+   }
+   for (int y = height - 2; y >= 0; --y) {
+      int row = y - maskY;
+      unsigned isMaskRow = row >= 0 && row < tetrominoMaxSize;
+      if (isMaskRow && (fullRows & (1u << row))) {
+         continue;
+      }
+      unsigned isMaskPixel = isMaskRow && isMaskColumn && (mask >> (row * tetrominoMaxSize + maskColumn) & 1);
+      if (isMaskPixel || (getOccupancyWindow(game, x, y) & 1)) {
+         return y + 1 - (row <= 0 ? 0 : countMaskBits(fullRows & ((1u << row) - 1)));
+      }
+   }
+   return 0;
+}
+
+TETRIS_ENGINE_API int evaluatePlacement(const Game* game, const Placement* placement, BoardFeatures* features) {
+   unsigned mask = game->activeTetromino->masks[placement->orientation];
+   if (isMaskColliding(game, mask, placement->x, placement->y)) {
+      return -1;
+   }
+   unsigned fullRows = 0;
+   int row = 0;
+   for (unsigned rows = mask; rows; rows >>= tetrominoMaxSize, ++row) {
+      unsigned rowMask = rows & ((1u << tetrominoMaxSize) - 1);
+      if (!rowMask) {
+         continue;
+      }
+      int y = placement->y + row;
+      if (y >= getGameHeight(game)) {
+         return -1;
+      }
+      if (game->rowFillCounts[y] + nibblePopCount[rowMask] == getGameWidth(game)) {
+         fullRows |= 1u << row;
+      }
+   }
+   int maskHeights[tetrominoMaxSize];
+   BoardFeatures result;
+   addTetrominoFeatures(game, mask, placement->x, placement->y, &result, maskHeights);
+   if (!fullRows) {
+      *features = result;
+      return 0;
+   }
+   int clearedRows = countMaskBits(fullRows);
+   result.lockedPixels -= (uint32_t) clearedRows * getGameWidth(game);
+   result.rowTransitions += 2 * (uint32_t) clearedRows;
+   clearColumnFeatures(&result);
+   int left = wallColumnHeight;
+   int height = getClearedColumnHeight(game, mask, placement->x, placement->y, maskHeights, fullRows, 0);
+   for (int x = 0; x < getGameWidth(game); ++x) {
+      int right = x + 1 < getGameWidth(game)
+            ? getClearedColumnHeight(game, mask, placement->x, placement->y, maskHeights, fullRows, x + 1)
+            : wallColumnHeight;
+      addColumnFeatures(&result, left, height, right);
+      left = height;
+      height = right;
+   }
+   result.holes = result.aggregateHeight - result.lockedPixels;
+   *features = result;
+   return clearedRows;
+}
+
+/*!
+ * \brief Вычисляет маску тетрамино, сдвинутую к началу координат.
+ * 
+ * \param[in] mask маска тетрамино (см. #ActiveTetromino::masks)
+ * \param[out] minX x-координата самого левого занятого пиксела
+ * \param[out] minY y-координата самого нижнего занятого пиксела
+ * 
+ * \return сдвинутая маска
+ */
+static uint16_t normalizeTetrominoMask(uint16_t mask, int* minX, int* minY) {
+   const unsigned column = 0x1111;
+   const unsigned row = (1u << tetrominoMaxSize) - 1;
+   *minX = 0;
+   *minY = 0;
+   if (!mask) {
+      return 0;
+   }
+   while (!(mask & (row << (*minY * tetrominoMaxSize)))) {
+      ++*minY;
+   }
+   while (!(mask & (column << *minX))) {
+      ++*minX;
+   }
+   // сдвиг вправо на minX не переносит биты между строками, так как левее
+   // minX в каждой строке пусто
+   return (uint16_t) (mask >> (*minY * tetrominoMaxSize + *minX));
+}
+
+/*!
+ * \brief Возвращает количество состояний (x, y, поворот) поиска положений.
+ * 
+ * x-координаты [-(#tetrominoMaxSize - 1) .. \a width), y-координаты
+ * [-(#tetrominoMaxSize - 1) .. \a height]: вне этих пределов у тетрамино
+ * нет ни одного допустимого положения.
+ * 
+ * \param[in] width ширина игрового стакана
+ * \param[in] height высота игрового стакана
+ * 
+ * \return количество состояний
+ */
+static inline size_t getPlacementStateCount(GameCoordinate width, GameCoordinate height) {
+   return (size_t) tetrominoOrientationCount * (height + tetrominoMaxSize) * (width + tetrominoMaxSize - 1);
+}
+
+TETRIS_ENGINE_API size_t placementScratchBytes(GameCoordinate width, GameCoordinate height) {
+   // очередь номеров состояний и флаги состояний
+   return getPlacementStateCount(width, height) * (sizeof(uint32_t) + sizeof(uint8_t));
+}
+
+TETRIS_ENGINE_API int findPlacementsWithScratch(Game* game, void* scratch, Placement* placements, unsigned capacity) {
+   startGameStatTimer(placementStart);
+   const ActiveTetromino* activeTetromino = game->activeTetromino;
+   const int columns = getGameWidth(game) + tetrominoMaxSize - 1;
+   const int rows = getGameHeight(game) + tetrominoMaxSize;
+   const int offset = tetrominoMaxSize - 1;
+   const size_t stateCount = getPlacementStateCount(getGameWidth(game), getGameHeight(game));
+   // номер состояния хранится в очереди в 32 битах
+   if (stateCount > UINT32_MAX) {
+      return -1;
+   }
+   uint32_t* queue = (uint32_t*) scratch;
+   // флаги состояний: 1 - посещено, 2 - положение уже записано
+   uint8_t* stateFlags = (uint8_t*) (queue + stateCount);
+   memset(stateFlags, 0, stateCount * sizeof(uint8_t));
+   // повороты с одинаковыми пикселами (с точностью до сдвига) сводятся к
+   // первому из них, чтобы каждое положение записывалось один раз
+   int canonicalOrientations[tetrominoOrientationCount];
+   int canonicalShiftX[tetrominoOrientationCount];
+   int canonicalShiftY[tetrominoOrientationCount];
+   uint16_t normalizedMasks[tetrominoOrientationCount];
+   int minX[tetrominoOrientationCount];
+   int minY[tetrominoOrientationCount];
+   for (int orientation = 0; orientation < tetrominoOrientationCount; ++orientation) {
+      normalizedMasks[orientation] = normalizeTetrominoMask(activeTetromino->masks[orientation], minX + orientation, minY + orientation);
+      canonicalOrientations[orientation] = orientation;
+      for (int other = 0; other < orientation; ++other) {
+         if (normalizedMasks[other] == normalizedMasks[orientation]) {
+            canonicalOrientations[orientation] = other;
+            break;
+         }
+      }
+      canonicalShiftX[orientation] = minX[orientation] - minX[canonicalOrientations[orientation]];
+      canonicalShiftY[orientation] = minY[orientation] - minY[canonicalOrientations[orientation]];
+   }
+#define placementStateIndex(orientation, x, y) \
+   ((size_t) ((orientation) * rows + (y) + offset) * columns + (x) + offset)
+   size_t head = 0;
+   size_t tail = 0;
+   unsigned found = 0;
+   size_t start = placementStateIndex(activeTetromino->orientation, activeTetromino->x, activeTetromino->y);
+   stateFlags[start] = 1;
+   queue[tail++] = (uint32_t) start;
+   while (head < tail) {
+      uint32_t state = queue[head++];
+      int x = (int) (state % columns) - offset;
+      int y = (int) (state / columns % rows) - offset;
+      int orientation = (int) (state / columns / rows);
+      uint16_t mask = activeTetromino->masks[orientation];
+      // сдвиги влево, вправо и вниз
+      int neighbours[3][2] = {
+         {x - 1, y},
+         {x + 1, y},
+         {x, y - 1},
+      };
+      for (int i = 0; i < 3; ++i) {
+         // проверка столкновения идет первой: только положения без
+         // столкновений гарантированно лежат в пределах stateFlags
+         if (isMaskColliding(game, mask, neighbours[i][0], neighbours[i][1])) {
+            continue;
+         }
+         size_t next = placementStateIndex(orientation, neighbours[i][0], neighbours[i][1]);
+         if (!(stateFlags[next] & 1)) {
+            stateFlags[next] |= 1;
+            queue[tail++] = (uint32_t) next;
+         }
+      }
+      if (!isMaskColliding(game, activeTetromino->clockwiseSweepMasks[orientation], x, y)) {
+         size_t next = placementStateIndex((orientation + 1) % tetrominoOrientationCount, x, y);
+         if (!(stateFlags[next] & 1)) {
+            stateFlags[next] |= 1;
+            queue[tail++] = (uint32_t) next;
+         }
+      }
+      if (!isMaskColliding(game, activeTetromino->againstClockwiseSweepMasks[orientation], x, y)) {
+         size_t next = placementStateIndex((orientation + tetrominoOrientationCount - 1) % tetrominoOrientationCount, x, y);
+         if (!(stateFlags[next] & 1)) {
+            stateFlags[next] |= 1;
+            queue[tail++] = (uint32_t) next;
+         }
+      }
+      // положение, в котором тетрамино не может упасть ниже. Если часть
+      // тетрамино остается над стаканом, то фиксация означает проигрыш
+      if (isMaskColliding(game, mask, x, y - 1)) {
+         int topY = y + tetrominoMaxSize - 1;
+         while (!(mask & (((1u << tetrominoMaxSize) - 1) << ((topY - y) * tetrominoMaxSize)))) {
+            --topY;
+         }
+         if (topY >= getGameHeight(game)) {
+            continue;
+         }
+         int canonicalOrientation = canonicalOrientations[orientation];
+         size_t canonical = placementStateIndex(canonicalOrientation,
+               x + canonicalShiftX[orientation], y + canonicalShiftY[orientation]);
+         if (stateFlags[canonical] & 2) {
+            continue;
+         }
+         stateFlags[canonical] |= 2;
+         if (found < capacity) {
+            placements[found].x = x;
+            placements[found].y = y;
+            placements[found].orientation = orientation;
+         }
+         ++found;
+      }
+   }
+#undef placementStateIndex
+   countGameStat(game, placementSearches);
+   addGameStat(game, placementStates, tail);
+   stopGameStatTimer(game, placementNanoseconds, placementStart);
+   return (int) found;
+}
+
+TETRIS_ENGINE_API int findPlacements(Game* game, Placement* placements, unsigned capacity) {
+   void* scratch = malloc(placementScratchBytes(getGameWidth(game), getGameHeight(game)));
+   if (!scratch) {
+      return -1;
+   }
+   int found = findPlacementsWithScratch(game, scratch, placements, capacity);
+   free(scratch);
+   return found;
+}
+
+/*!
+ * \brief Двигает тетрамино влево.
+ * 
+ * \param[in,out] game указатель на структуру
+ * 
+ * \return  
+ *          - 1) \a 0 если тетрамино удалось подвинуть влево
+ *          - 2) \a 1 если тетрамино не удалось подвинуть влево
+ */
+TETRIS_ENGINE_API unsigned moveLeft(Game* game) {
+   countGameStat(game, inputCalls[moveLeftInput]);
+   if (isMaskColliding(game, game->activeTetromino->masks[game->activeTetromino->orientation],
+         game->activeTetromino->x - 1, game->activeTetromino->y)) {
+      countGameStat(game, inputFailures[moveLeftInput]);
+      return 1;
+   }
+   popActiveTetrominoInfo(game);
+   --game->activeTetromino->x;
+   pushActiveTetrominoInfo(game);
+   publishGameView(game);
+   return 0;
+}
+
+/*!
+ * \brief Двигает тетрамино вправо.
+ * 
+ * \param[in,out] game указатель на структуру
+ * 
+ * \return
+ *          - 1) \a 0 если тетрамино удалось подвинуть вправо
+ *          - 2) \a 1 если тетрамино не удалось подвинуть вправо
+ */
+TETRIS_ENGINE_API unsigned moveRight(Game* game) {
+   countGameStat(game, inputCalls[moveRightInput]);
+   if (isMaskColliding(game, game->activeTetromino->masks[game->activeTetromino->orientation],
+         game->activeTetromino->x + 1, game->activeTetromino->y)) {
+      countGameStat(game, inputFailures[moveRightInput]);
+      return 1;
+   }
+   popActiveTetrominoInfo(game);
+   ++game->activeTetromino->x;
+   pushActiveTetrominoInfo(game);
+   publishGameView(game);
+   return 0;
+}
+
+/*!
+ * \brief Вызывает функцию, соответствующую вводу.
+ * 
+ * \param[in,out] game указатель на структуру
+ * \param[in] input ввод
+ * 
+ * \return значение, которое вернула функция, или \a 0 для #noneInput
+ */
+static inline unsigned dispatchInput(Game* game, GameInput input) {
+   switch (input) {
+      case moveLeftInput:
+         return moveLeft(game);
+      case moveRightInput:
+         return moveRight(game);
+      case rotateClockwiseInput:
+         return rotateClockwise(game);
+      case rotateAgainstClockwiseInput:
+         return rotateAgainstClockwise(game);
+      case tickInput:
+         return tick(game);
+      case softDropInput:
+         return softDrop(game, 1, NULL);
+      case hardDropInput:
+         return hardDrop(game, NULL);
+      default:
+         return 0;
+   }
+}
+
+TETRIS_ENGINE_API unsigned applyInput(Game* game, GameInput input) {
+#ifdef TETRIS_ENGINE_STATS_TIMERS
+   if ((unsigned) input < gameInputCount) {
+      startGameStatTimer(inputStart);
+      unsigned result = dispatchInput(game, input);
+      stopGameStatTimer(game, inputNanoseconds[input], inputStart);
+      return result;
+   }
+#endif
+   return dispatchInput(game, input);
+}
+
+/*!
+ * \brief Возвращает хеш вида тетрамино: его размера и пикселов.
+ * 
+ * \param[in] pixels пикселы тетрамино
+ * \param[in] size #NextTetromino::size тетрамино
+ * 
+ * \return хеш
+ */
+static uint64_t getTetrominoHash(const TetrominoPixel* pixels, int8_t size) {
+   uint64_t hash = (uint64_t) (uint8_t) size;
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      hash = (hash ^ pixels[i]) * 0x100000001B3ull;
+   }
+   return mixGameHash(hash);
+}
+
+TETRIS_ENGINE_API uint64_t getGameHash(const Game* game) {
+   uint64_t hash = game->boardHash;
+   if (isActiveTetrominoShown(game)) {
+      const ActiveTetromino* activeTetromino = game->activeTetromino;
+      uint64_t position = (uint64_t) (uint32_t) activeTetromino->x | (uint64_t) (uint32_t) activeTetromino->y << 32;
+      hash ^= mixGameHash(getTetrominoHash(activeTetromino->orientationPixels, activeTetromino->size)
+            ^ mixGameHash(mixGameHash(position + 1) ^ activeTetromino->orientation));
+   }
+   if (game->tetrominoQueue.count) {
+      // сдвиг отличает следующее тетрамино от такого же активного
+      uint64_t nextHash = getTetrominoHash(game->nextTetromino->pixels, game->nextTetromino->size);
+      hash ^= nextHash << 1 | nextHash >> 63;
+   }
+   return hash;
+}
+
+/*!
+ * \brief Заголовок снимка игры.
+ * 
+ * За заголовком в снимке подряд лежат #Game::occupancy, #Game::rowHashes,
+ * #ActiveTetromino::orientationPixels, #TetrominoQueue::pixels,
+ * #TetrominoQueue::sizes,
+ * #Game::gameField, #Game::columnHeights и #Game::rowFillCounts.
+ */
+typedef struct tagGameSnapshotHeader {
+   GameCoordinate width;             ///< #Game::width
+   GameCoordinate height;            ///< #Game::height
+   GameStatus status;                ///< #Game::status
+   GameFieldMode fieldMode;          ///< #Game::fieldMode
+   uint32_t score;                   ///< #Game::score
+   BoardFeatures boardFeatures;      ///< #Game::boardFeatures
+   uint64_t boardHash;               ///< #Game::boardHash
+   ActiveTetromino activeTetromino;  ///< #Game::activeTetromino. Указатели не используются
+   uint8_t queueHead;                ///< #TetrominoQueue::head
+   uint8_t queueCount;               ///< #TetrominoQueue::count
+   uint32_t queueTotal;              ///< #TetrominoQueue::total
+   TetrominoGenerator tetrominoGenerator; ///< #Game::tetrominoGenerator
+} GameSnapshotHeader;
+
+/*!
+ * \brief Смещения массивов игры в снимке.
+ */
+typedef struct tagGameSnapshotLayout {
+   size_t occupancy;         ///< #Game::occupancy
+   size_t rowHashes;         ///< #Game::rowHashes
+   size_t orientationPixels; ///< #ActiveTetromino::orientationPixels
+   size_t queuePixels;       ///< #TetrominoQueue::pixels
+   size_t queueSizes;        ///< #TetrominoQueue::sizes
+   size_t gameField;         ///< #Game::gameField
+   size_t columnHeights;     ///< #Game::columnHeights
+   size_t rowFillCounts;     ///< #Game::rowFillCounts
+   size_t size;              ///< размер всего снимка
+} GameSnapshotLayout;
+
+/*!
+ * \brief Вычисляет расположение массивов игры в снимке.
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return смещения массивов
+ */
+static GameSnapshotLayout getGameSnapshotLayout(const Game* game) {
+   GameSnapshotLayout layout;
+   layout.occupancy = alignMemoryBlock(sizeof(GameSnapshotHeader));
+   layout.rowHashes = layout.occupancy
+         + (size_t) (getGameHeight(game) + 2 * occupancyPadding) * getGameOccupancyRowWords(game) * sizeof(uint64_t);
+   layout.orientationPixels = layout.rowHashes + getGameHeight(game) * sizeof(uint64_t);
+   layout.queuePixels = layout.orientationPixels + tetrominoOrientationCount * tetrominoArrayMaxSize * sizeof(TetrominoPixel);
+   layout.queueSizes = layout.queuePixels + tetrominoQueueCapacity * tetrominoArrayMaxSize * sizeof(TetrominoPixel);
+   layout.gameField = layout.queueSizes + tetrominoQueueCapacity * sizeof(int8_t);
+   layout.columnHeights = layout.gameField + (size_t) getGameWidth(game) * getGameHeight(game) * sizeof(TetrominoPixel);
+   layout.rowFillCounts = layout.columnHeights + getGameWidth(game) * sizeof(GameCoordinate);
+   layout.size = alignMemoryBlock(layout.rowFillCounts + getGameHeight(game) * sizeof(GameCoordinate));
+   return layout;
+}
+
+/*!
+ * \brief Копирует активное тетрамино, сохраняя указатели на память
+ * приемника.
+ * 
+ * \param[out] destination приемник
+ * \param[in] source источник. Его указатели не используются
+ * \param[in] sourceOrientationPixels пикселы всех поворотов источника
+ */
+static void copyActiveTetromino(ActiveTetromino* destination, const ActiveTetromino* source,
+      const TetrominoPixel* sourceOrientationPixels) {
+   TetrominoPixelArray orientationPixels = destination->orientationPixels;
+   *destination = *source;
+   destination->orientationPixels = orientationPixels;
+   destination->pixels = orientationPixels + source->orientation * tetrominoArrayMaxSize;
+   memcpy(orientationPixels, sourceOrientationPixels,
+         tetrominoOrientationCount * tetrominoArrayMaxSize * sizeof(TetrominoPixel));
+}
+
+/*!
+ * \brief Копирует очередь следующих тетрамино, сохраняя указатели на память
+ * приемника.
+ * 
+ * #Game::nextTetromino начинает указывать на первый элемент скопированной
+ * очереди.
+ * 
+ * \param[in,out] game приемник
+ * \param[in] head #TetrominoQueue::head источника
+ * \param[in] count #TetrominoQueue::count источника
+ * \param[in] sourcePixels #TetrominoQueue::pixels источника
+ * \param[in] sourceSizes #TetrominoQueue::sizes источника
+ */
+static void copyTetrominoQueue(Game* game, uint8_t head, uint8_t count,
+      const TetrominoPixel* sourcePixels, const int8_t* sourceSizes) {
+   TetrominoQueue* queue = &game->tetrominoQueue;
+   queue->head = head;
+   queue->count = count;
+   memcpy(queue->pixels, sourcePixels, tetrominoQueueCapacity * tetrominoArrayMaxSize * sizeof(TetrominoPixel));
+   memcpy(queue->sizes, sourceSizes, tetrominoQueueCapacity * sizeof(int8_t));
+   game->nextTetromino->size = queue->sizes[queue->head];
+   game->nextTetromino->pixels = queue->pixels + queue->head * tetrominoArrayMaxSize;
+}
+
+TETRIS_ENGINE_API size_t gameSnapshotSize(const Game* game) {
+   return getGameSnapshotLayout(game).size;
+}
+
+TETRIS_ENGINE_API void snapshotGame(const Game* game, void* buffer) {
+   GameSnapshotLayout layout = getGameSnapshotLayout(game);
+   uint8_t* bytes = (uint8_t*) buffer;
+   GameSnapshotHeader* header = (GameSnapshotHeader*) bytes;
+   header->width = getGameWidth(game);
+   header->height = getGameHeight(game);
+   header->status = game->status;
+   header->fieldMode = game->fieldMode;
+   header->score = game->score;
+   header->boardFeatures = game->boardFeatures;
+   header->boardHash = game->boardHash;
+   header->activeTetromino = *game->activeTetromino;
+   header->queueHead = game->tetrominoQueue.head;
+   header->queueCount = game->tetrominoQueue.count;
+   header->queueTotal = game->tetrominoQueue.total;
+   header->tetrominoGenerator = game->tetrominoGenerator;
+   memcpy(bytes + layout.occupancy, game->occupancy, layout.rowHashes - layout.occupancy);
+   memcpy(bytes + layout.rowHashes, game->rowHashes, layout.orientationPixels - layout.rowHashes);
+   memcpy(bytes + layout.orientationPixels, game->activeTetromino->orientationPixels,
+         layout.queuePixels - layout.orientationPixels);
+   memcpy(bytes + layout.queuePixels, game->tetrominoQueue.pixels, layout.queueSizes - layout.queuePixels);
+   memcpy(bytes + layout.queueSizes, game->tetrominoQueue.sizes, layout.gameField - layout.queueSizes);
+   memcpy(bytes + layout.gameField, game->gameField, layout.columnHeights - layout.gameField);
+   memcpy(bytes + layout.columnHeights, game->columnHeights, layout.rowFillCounts - layout.columnHeights);
+   memcpy(bytes + layout.rowFillCounts, game->rowFillCounts, getGameHeight(game) * sizeof(GameCoordinate));
+}
+
+TETRIS_ENGINE_API unsigned restoreGame(Game* game, const void* buffer) {
+   const uint8_t* bytes = (const uint8_t*) buffer;
+   const GameSnapshotHeader* header = (const GameSnapshotHeader*) bytes;
+   if (header->width != getGameWidth(game) || header->height != getGameHeight(game)) {
+      return 1;
+   }
+   GameSnapshotLayout layout = getGameSnapshotLayout(game);
+   game->status = header->status;
+   game->score = header->score;
+   game->boardFeatures = header->boardFeatures;
+   game->boardHash = header->boardHash;
+   copyActiveTetromino(game->activeTetromino, &header->activeTetromino, bytes + layout.orientationPixels);
+   internActiveTetrominoShape(game);
+   copyTetrominoQueue(game, header->queueHead, header->queueCount, bytes + layout.queuePixels,
+         (const int8_t*) (bytes + layout.queueSizes));
+   game->tetrominoQueue.total = header->queueTotal;
+   game->tetrominoGenerator = header->tetrominoGenerator;
+   memcpy(game->occupancy, bytes + layout.occupancy, layout.rowHashes - layout.occupancy);
+   memcpy(game->rowHashes, bytes + layout.rowHashes, layout.orientationPixels - layout.rowHashes);
+   memcpy(game->gameField, bytes + layout.gameField, layout.columnHeights - layout.gameField);
+   memcpy(game->columnHeights, bytes + layout.columnHeights, layout.rowFillCounts - layout.columnHeights);
+   memcpy(game->rowFillCounts, bytes + layout.rowFillCounts, getGameHeight(game) * sizeof(GameCoordinate));
+   convertGameField(game, header->fieldMode);
+   markGameDirty(game);
+   publishGameView(game);
+   return 0;
+}
+
+TETRIS_ENGINE_API unsigned cloneGame(Game* destination, const Game* source) {
+   if (getGameWidth(destination) != getGameWidth(source) || getGameHeight(destination) != getGameHeight(source)) {
+      return 1;
+   }
+   if (destination == source) {
+      return 0;
+   }
+   GameSnapshotLayout layout = getGameSnapshotLayout(source);
+   destination->status = source->status;
+   destination->score = source->score;
+   destination->boardFeatures = source->boardFeatures;
+   destination->boardHash = source->boardHash;
+   copyActiveTetromino(destination->activeTetromino, source->activeTetromino, source->activeTetromino->orientationPixels);
+   internActiveTetrominoShape(destination);
+   copyTetrominoQueue(destination, source->tetrominoQueue.head, source->tetrominoQueue.count,
+         source->tetrominoQueue.pixels, source->tetrominoQueue.sizes);
+   destination->tetrominoQueue.total = source->tetrominoQueue.total;
+   destination->tetrominoGenerator = source->tetrominoGenerator;
+   memcpy(destination->occupancy, source->occupancy, layout.rowHashes - layout.occupancy);
+   memcpy(destination->rowHashes, source->rowHashes, layout.orientationPixels - layout.rowHashes);
+   memcpy(destination->gameField, source->gameField, layout.columnHeights - layout.gameField);
+   memcpy(destination->columnHeights, source->columnHeights, layout.rowFillCounts - layout.columnHeights);
+   memcpy(destination->rowFillCounts, source->rowFillCounts, getGameHeight(source) * sizeof(GameCoordinate));
+   convertGameField(destination, source->fieldMode);
+   markGameDirty(destination);
+   publishGameView(destination);
+   return 0;
+}
+
+/*!
+ * \brief Размер заголовка журнала игры в байтах.
+ * 
+ * Заголовок: "TLOG", версия, #Game::width, #Game::height (по 2 байта),
+ * #TetrominoGenerator::type, #TetrominoGenerator::bagPosition,
+ * #TetrominoGenerator::bag, #TetrominoGenerator::state (8 байт),
+ * #GameRecorder::checksumInterval, #GameRecorder::ticks и размеры потоков
+ * событий, тетрамино и контрольных сумм (по 4 байта). Числа записаны от
+ * младшего байта к старшему.
+ */
+#define gameLogHeaderSize 46
+
+/*!
+ * \brief Версия формата журнала игры.
+ */
+#define gameLogVersion 3
+
+/*!
+ * \brief Записывает число в \a count байтов от младшего к старшему.
+ * 
+ * \param[out] bytes байты
+ * \param[in] value число
+ * \param[in] count количество байтов
+ */
+static void writeLittleEndian(uint8_t* bytes, uint64_t value, int count) {
+   for (int i = 0; i < count; ++i) {
+      bytes[i] = (uint8_t) (value >> (8 * i));
+   }
+}
+
+/*!
+ * \brief Читает число из \a count байтов от младшего к старшему.
+ * 
+ * \param[in] bytes байты
+ * \param[in] count количество байтов
+ * 
+ * \return число
+ */
+static uint64_t readLittleEndian(const uint8_t* bytes, int count) {
+   uint64_t value = 0;
+   for (int i = 0; i < count; ++i) {
+      value |= (uint64_t) bytes[i] << (8 * i);
+   }
+   return value;
+}
+
+/*!
+ * \brief Вызывает \a action для каждого зафиксированного пиксела ниже
+ * строки \a stackHeight по строкам снизу вверх.
+ * 
+ * \param[in] game указатель на структуру
+ * \param[in] stackHeight количество строк
+ * \param[in] action действие с пикселом \a pixel в \a x:y
+ */
+#define forEachLockedPixel(game, stackHeight, action) \
+   for (int y = 0; y < (stackHeight); ++y) { \
+      for (int chunkX = 0; chunkX < getGameWidth(game); chunkX += 32) { \
+         int chunkWidth = getGameWidth(game) - chunkX < 32 ? getGameWidth(game) - chunkX : 32; \
+         unsigned bits = getOccupancyBits(game, chunkX, y, chunkWidth); \
+         for (int x = chunkX; bits; ++x, bits >>= 1) { \
+            if (bits & 1) { \
+               TetrominoPixel pixel = flatArrayAs2D((game)->gameField, x, y, getGameWidth(game)); \
+               action; \
+            } \
+         } \
+      } \
+   }
+
+/*!
+ * \brief Вычисляет контрольную сумму состояния игры.
+ * 
+ * Учитывает статус, очки, положение активного тетрамино, битовую доску и
+ * цвета зафиксированных пикселов. Пикселы активного тетрамино в стакане не
+ * учитываются, поэтому сумма не зависит от #GameFieldMode.
+ * 
+ * \param[in] game указатель на структуру
+ * 
+ * \return контрольная сумма
+ */
+static uint32_t getGameChecksum(const Game* game) {
+   const ActiveTetromino* activeTetromino = game->activeTetromino;
+   uint64_t hash = 0xCBF29CE484222325ull;
+#define mixGameChecksum(value) hash = (hash ^ (uint64_t) (value)) * 0x100000001B3ull
+   mixGameChecksum(game->status);
+   mixGameChecksum(game->score);
+   mixGameChecksum((uint16_t) activeTetromino->x | (uint32_t) (uint16_t) activeTetromino->y << 16
+         | (uint64_t) activeTetromino->orientation << 32);
+   mixGameChecksum(activeTetromino->masks[activeTetromino->orientation]);
+   for (int word = 0; word < getGameHeight(game) * getGameOccupancyRowWords(game); ++word) {
+      mixGameChecksum(getOccupancyRow(game, 0)[word]);
+   }
+   forEachLockedPixel(game, getGameHeight(game), mixGameChecksum(pixel));
+#undef mixGameChecksum
+   return (uint32_t) (hash ^ (hash >> 32));
+}
+
+/*!
+ * \brief Резервирует место в потоке журнала.
+ * 
+ * \param[out] outOfMemory при нехватке памяти выставляется в \a 1, например,
+ * #GameRecorder::outOfMemory
+ * \param[in,out] stream поток
+ * \param[in] bytes количество байтов, которые будут дописаны
+ * 
+ * \return указатель на место для записи или \a NULL при нехватке памяти
+ */
+static uint8_t* reserveLogStream(unsigned* outOfMemory, GameLogStream* stream, size_t bytes) {
+   if (stream->size + bytes > stream->capacity) {
+      size_t capacity = stream->capacity ? stream->capacity : 256;
+      while (capacity < stream->size + bytes) {
+         capacity *= 2;
+      }
+      uint8_t* data = (uint8_t*) realloc(stream->data, capacity);
+      if (!data) {
+         *outOfMemory = 1;
+         return NULL;
+      }
+      stream->data = data;
+      stream->capacity = capacity;
+   }
+   uint8_t* place = stream->data + stream->size;
+   stream->size += bytes;
+   return place;
+}
+
+/*!
+ * \brief Дописывает в поток число переменной длины (по 7 бит в байте,
+ * старший бит - признак продолжения).
+ * 
+ * \param[in,out] recorder запись
+ * \param[in,out] stream поток
+ * \param[in] value число
+ */
+static void appendLogVarint(GameRecorder* recorder, GameLogStream* stream, uint64_t value) {
+   uint8_t bytes[10];
+   size_t count = 0;
+   do {
+      bytes[count++] = (uint8_t) ((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+      value >>= 7;
+   } while (value);
+   uint8_t* place = reserveLogStream(&recorder->outOfMemory, stream, count);
+   if (place) {
+      memcpy(place, bytes, count);
+   }
+}
+
+/*!
+ * \brief Записывает тетрамино, добавленные в очередь после последней записи.
+ * 
+ * Для встроенных случайных генераторов ничего не делает.
+ * 
+ * \param[in,out] recorder запись
+ */
+static void recordNewTetrominoes(GameRecorder* recorder) {
+   const TetrominoQueue* queue = &recorder->game->tetrominoQueue;
+   TetrominoGeneratorType type = recorder->initialGenerator.type;
+   if (type != functionTetrominoGenerator && type != sequenceTetrominoGenerator) {
+      return;
+   }
+   uint32_t fresh = queue->total - recorder->loggedTetrominoes;
+   // новые тетрамино - последние fresh элементов очереди. Первое из них могло
+   // уже стать активным, но его пикселы в очереди ещё не перезаписаны
+   unsigned slot = (queue->head + queue->count + tetrominoQueueCapacity - fresh) % tetrominoQueueCapacity;
+   for (uint32_t i = 0; i < fresh; ++i, slot = (slot + 1) % tetrominoQueueCapacity) {
+      TetrominoPixelArray pixels = queue->pixels + slot * tetrominoArrayMaxSize;
+      unsigned mask = computeTetrominoMask(pixels);
+      uint8_t* place = reserveLogStream(&recorder->outOfMemory, &recorder->tetrominoes, 3 + nibblePopCount[mask & 0xF]
+            + nibblePopCount[(mask >> 4) & 0xF] + nibblePopCount[(mask >> 8) & 0xF] + nibblePopCount[mask >> 12]);
+      if (!place) {
+         return;
+      }
+      *place++ = (uint8_t) queue->sizes[slot];
+      writeLittleEndian(place, mask, 2);
+      place += 2;
+      for (int pixel = 0; pixel < tetrominoArrayMaxSize; ++pixel) {
+         if (pixels[pixel]) {
+            *place++ = pixels[pixel];
+         }
+      }
+   }
+   recorder->loggedTetrominoes = queue->total;
+}
+
+TETRIS_ENGINE_API void startRecordedGame(GameRecorder* recorder, Game* game, uint32_t checksumInterval) {
+   memset(recorder, 0, sizeof(GameRecorder));
+   recorder->game = game;
+   recorder->initialGenerator = game->tetrominoGenerator;
+   recorder->checksumInterval = checksumInterval;
+   startGame(game);
+   recordNewTetrominoes(recorder);
+}
+
+TETRIS_ENGINE_API int recordInput(GameRecorder* recorder, GameInput input) {
+   Game* game = recorder->game;
+   // неизвестный ввод applyInput игнорирует, а в журнале он испортил бы
+   // количество тиков события
+   if (game->status != playGameStatus || (unsigned) input >= gameInputCount) {
+      return 0;
+   }
+   unsigned result = applyInput(game, input);
+   if (input == tickInput) {
+      ++recorder->ticks;
+      ++recorder->pendingTicks;
+      if (recorder->checksumInterval && recorder->ticks % recorder->checksumInterval == 0) {
+         uint8_t* place = reserveLogStream(&recorder->outOfMemory, &recorder->checksums, 4);
+         if (place) {
+            writeLittleEndian(place, getGameChecksum(game), 4);
+         }
+      }
+   } else if (input != noneInput) {
+      appendLogVarint(recorder, &recorder->events, (uint64_t) recorder->pendingTicks << 3 | input);
+      recorder->pendingTicks = 0;
+   }
+   recordNewTetrominoes(recorder);
+   return recorder->outOfMemory ? -1 : (int) result;
+}
+
+TETRIS_ENGINE_API uint8_t* finishGameRecording(GameRecorder* recorder, size_t* size) {
+   if (recorder->pendingTicks) {
+      appendLogVarint(recorder, &recorder->events, (uint64_t) recorder->pendingTicks << 3 | noneInput);
+      recorder->pendingTicks = 0;
+   }
+   size_t dataSize = recorder->events.size + recorder->tetrominoes.size + recorder->checksums.size;
+   uint8_t* log = recorder->outOfMemory ? NULL : (uint8_t*) malloc(gameLogHeaderSize + dataSize);
+   if (log) {
+      const TetrominoGenerator* generator = &recorder->initialGenerator;
+      memcpy(log, "TLOG", 4);
+      log[4] = gameLogVersion;
+      writeLittleEndian(log + 5, (uint16_t) getGameWidth(recorder->game), 2);
+      writeLittleEndian(log + 7, (uint16_t) getGameHeight(recorder->game), 2);
+      log[9] = (uint8_t) generator->type;
+      log[10] = generator->bagPosition;
+      memcpy(log + 11, generator->bag, tetrominoKindCount);
+      writeLittleEndian(log + 18, generator->state, 8);
+      writeLittleEndian(log + 26, recorder->checksumInterval, 4);
+      writeLittleEndian(log + 30, recorder->ticks, 4);
+      writeLittleEndian(log + 34, recorder->events.size, 4);
+      writeLittleEndian(log + 38, recorder->tetrominoes.size, 4);
+      writeLittleEndian(log + 42, recorder->checksums.size, 4);
+      uint8_t* place = log + gameLogHeaderSize;
+      const GameLogStream* streams[3] = {&recorder->events, &recorder->tetrominoes, &recorder->checksums};
+      for (int i = 0; i < 3; ++i) {
+         if (streams[i]->size) {
+            memcpy(place, streams[i]->data, streams[i]->size);
+            place += streams[i]->size;
+         }
+      }
+      *size = gameLogHeaderSize + dataSize;
+   }
+   freeGameRecorder(recorder);
+   return log;
+}
+
+TETRIS_ENGINE_API void freeGameRecorder(GameRecorder* recorder) {
+   free(recorder->events.data);
+   free(recorder->tetrominoes.data);
+   free(recorder->checksums.data);
+   recorder->events.data = recorder->tetrominoes.data = recorder->checksums.data = NULL;
+   recorder->events.size = recorder->tetrominoes.size = recorder->checksums.size = 0;
+   recorder->events.capacity = recorder->tetrominoes.capacity = recorder->checksums.capacity = 0;
+}
+
+TETRIS_ENGINE_API unsigned replayGameLog(Game* game, const uint8_t* log, size_t size, uint32_t* ticks) {
+   uint32_t replayedTicks = 0;
+   if (ticks) {
+      *ticks = 0;
+   }
+   if (size < gameLogHeaderSize || memcmp(log, "TLOG", 4) || log[4] != gameLogVersion
+         || readLittleEndian(log + 5, 2) != (uint16_t) getGameWidth(game)
+         || readLittleEndian(log + 7, 2) != (uint16_t) getGameHeight(game)
+         || log[9] > logTetrominoGenerator || game->status != initGameStatus) {
+      return 1;
+   }
+   uint32_t checksumInterval = (uint32_t) readLittleEndian(log + 26, 4);
+   uint32_t totalTicks = (uint32_t) readLittleEndian(log + 30, 4);
+   size_t eventsSize = (size_t) readLittleEndian(log + 34, 4);
+   size_t tetrominoesSize = (size_t) readLittleEndian(log + 38, 4);
+   size_t checksumsSize = (size_t) readLittleEndian(log + 42, 4);
+   if (gameLogHeaderSize + eventsSize + tetrominoesSize + checksumsSize != size) {
+      return 1;
+   }
+   const uint8_t* events = log + gameLogHeaderSize;
+   const uint8_t* checksums = events + eventsSize + tetrominoesSize;
+   TetrominoGenerator* generator = &game->tetrominoGenerator;
+   TetrominoGeneratorType type = (TetrominoGeneratorType) log[9];
+   if (type == functionTetrominoGenerator || type == sequenceTetrominoGenerator) {
+      generator->type = logTetrominoGenerator;
+      generator->sequence = events + eventsSize;
+      generator->sequenceLength = (unsigned) tetrominoesSize;
+      generator->sequencePosition = 0;
+   } else {
+      generator->type = type;
+      generator->bagPosition = log[10];
+      memcpy(generator->bag, log + 11, tetrominoKindCount);
+      generator->state = readLittleEndian(log + 18, 8);
+   }
+   startGame(game);
+   size_t position = 0;
+   while (position < eventsSize) {
+      uint64_t value = 0;
+      int shift = 0;
+      uint8_t byte;
+      do {
+         if (position == eventsSize || shift > 63) {
+            return 1;
+         }
+         byte = events[position++];
+         value |= (uint64_t) (byte & 0x7F) << shift;
+         shift += 7;
+      } while (byte & 0x80);
+      for (uint64_t tickIndex = value >> 3; tickIndex; --tickIndex) {
+         if (game->status != playGameStatus) {
+            return 2;
+         }
+         tick(game);
+         ++replayedTicks;
+         if (ticks) {
+            *ticks = replayedTicks;
+         }
+         if (checksumInterval && replayedTicks % checksumInterval == 0) {
+            size_t offset = (size_t) (replayedTicks / checksumInterval - 1) * 4;
+            if (offset + 4 > checksumsSize) {
+               return 1;
+            }
+            if ((uint32_t) readLittleEndian(checksums + offset, 4) != getGameChecksum(game)) {
+               return 2;
+            }
+         }
+      }
+      GameInput input = (GameInput) (value & 7);
+      if (input != noneInput) {
+         if (game->status != playGameStatus) {
+            return 2;
+         }
+         applyInput(game, input);
+      }
+   }
+   return replayedTicks == totalTicks ? 0 : 1;
+}
+
+/*!
+ * \brief Вид тетрамино в упакованном состоянии игры, после которого
+ * записаны его размер, маска и пикселы.
+ */
+#define customPackedTetromino tetrominoKindCount
+
+/*!
+ * \brief Наибольшее количество бит одного тетрамино в упакованном состоянии
+ * игры.
+ */
+#define packedTetrominoMaxBits (3 + 3 + tetrominoArrayMaxSize + 1 + 8 * tetrominoArrayMaxSize)
+
+/*!
+ * \brief Наибольшая длина серии пикселов одного цвета в упакованном
+ * состоянии игры.
+ */
+#define packedColorRunMaxLength 8
+
+/*!
+ * \brief Запись упакованного состояния игры в буфер по битам.
+ * 
+ * Биты записываются от младшего к старшему.
+ */
+typedef struct tagPackedStateWriter {
+   uint8_t* bytes;        ///< буфер
+   size_t capacity;       ///< размер буфера
+   size_t size;           ///< количество записанных байтов
+   uint64_t bits;         ///< биты, еще не записанные в буфер
+   int bitCount;          ///< количество бит в #bits
+   unsigned isOverflowed; ///< не \a 0, если буфер закончился
+} PackedStateWriter;
+
+/*!
+ * \brief Чтение упакованного состояния игры по битам.
+ */
+typedef struct tagPackedStateReader {
+   const uint8_t* bytes;  ///< буфер
+   size_t size;           ///< размер буфера
+   size_t position;       ///< количество прочитанных байтов
+   uint64_t bits;         ///< прочитанные, но еще не возвращенные биты
+   int bitCount;          ///< количество бит в #bits
+   unsigned isOverflowed; ///< не \a 0, если буфер закончился
+} PackedStateReader;
+
+/*!
+ * \brief Записывает младшие \a count бит числа.
+ * 
+ * \param[in,out] writer запись
+ * \param[in] value число
+ * \param[in] count количество бит. Не больше \a 32
+ */
+static inline void writePackedBits(PackedStateWriter* writer, uint32_t value, int count) {
+   writer->bits |= ((uint64_t) value & (((uint64_t) 1 << count) - 1)) << writer->bitCount;
+   for (writer->bitCount += count; writer->bitCount >= 8; writer->bitCount -= 8, writer->bits >>= 8) {
+      if (writer->size < writer->capacity) {
+         writer->bytes[writer->size++] = (uint8_t) writer->bits;
+      } else {
+         writer->isOverflowed = 1;
+      }
+   }
+}
+
+/*!
+ * \brief Читает \a count бит.
+ * 
+ * За концом буфера читаются нулевые биты.
+ * 
+ * \param[in,out] reader чтение
+ * \param[in] count количество бит. Не больше \a 32
+ * 
+ * \return число
+ */
+static inline uint32_t readPackedBits(PackedStateReader* reader, int count) {
+   for (; reader->bitCount < count; reader->bitCount += 8) {
+      if (reader->position < reader->size) {
+         reader->bits |= (uint64_t) reader->bytes[reader->position++] << reader->bitCount;
+      } else {
+         reader->isOverflowed = 1;
+      }
+   }
+   uint32_t value = (uint32_t) (reader->bits & (((uint64_t) 1 << count) - 1));
+   reader->bits >>= count;
+   reader->bitCount -= count;
+   return value;
+}
+
+/*!
+ * \brief Возвращает количество бит, достаточное для чисел [0 .. \a count).
+ * 
+ * \param[in] count количество чисел
+ * 
+ * \return количество бит
+ */
+static inline int getPackedIndexBits(unsigned count) {
+   int bits = 0;
+   while (count > (1u << bits)) {
+      ++bits;
+   }
+   return bits;
+}
+
+/*!
+ * \brief Записывает тетрамино.
+ * 
+ * Стандартное тетрамино (см. #TetrominoKind) записывается своим видом в
+ * трех битах. Остальные - #customPackedTetromino, #NextTetromino::size в
+ * трех битах, маской (см. #ActiveTetromino::masks), битом одноцветности и
+ * цветом (одноцветное) или цветами всех занятых пикселов по порядку.
+ * 
+ * \param[in,out] writer запись
+ * \param[in] pixels пикселы тетрамино
+ * \param[in] size #NextTetromino::size тетрамино
+ */
+static void writePackedTetromino(PackedStateWriter* writer, const TetrominoPixel* pixels, int8_t size) {
+   uint16_t mask = 0;
+   TetrominoPixel color = 0;
+   unsigned isSingleColor = 1;
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      if (pixels[i]) {
+         mask |= 1u << i;
+         isSingleColor &= !color || pixels[i] == color;
+         color = pixels[i];
+      }
+   }
+   for (unsigned kind = 0; kind < tetrominoKindCount; ++kind) {
+      if (mask == standardTetrominoMasks[kind] && size == standardTetrominoSizes[kind] && isSingleColor
+            && color == kind + 1) {
+         writePackedBits(writer, kind, 3);
+         return;
+      }
+   }
+   writePackedBits(writer, customPackedTetromino, 3);
+   writePackedBits(writer, (uint32_t) size, 3);
+   writePackedBits(writer, mask, tetrominoArrayMaxSize);
+   writePackedBits(writer, isSingleColor, 1);
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      if (pixels[i]) {
+         writePackedBits(writer, pixels[i], 8);
+         if (isSingleColor) {
+            break;
+         }
+      }
+   }
+}
+
+/*!
+ * \brief Читает тетрамино, записанное #writePackedTetromino.
+ * 
+ * \param[in,out] reader чтение
+ * \param[out] pixels пикселы тетрамино
+ * \param[out] size #NextTetromino::size тетрамино
+ * 
+ * \return
+ *          - 1) \a 0 если тетрамино прочитано;
+ *          - 2) \a 1 если оно испорчено.
+ */
+static unsigned readPackedTetromino(PackedStateReader* reader, TetrominoPixel* pixels, int8_t* size) {
+   unsigned kind = readPackedBits(reader, 3);
+   if (kind != customPackedTetromino) {
+      uint16_t mask = standardTetrominoMasks[kind];
+      for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+         pixels[i] = (mask >> i) & 1 ? (TetrominoPixel) (kind + 1) : 0;
+      }
+      *size = standardTetrominoSizes[kind];
+      return 0;
+   }
+   *size = (int8_t) readPackedBits(reader, 3);
+   unsigned mask = readPackedBits(reader, tetrominoArrayMaxSize);
+   unsigned isSingleColor = readPackedBits(reader, 1);
+   TetrominoPixel color = 0;
+   for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+      if ((mask >> i) & 1) {
+         if (!isSingleColor || !color) {
+            color = (TetrominoPixel) readPackedBits(reader, 8);
+         }
+         pixels[i] = color;
+      } else {
+         pixels[i] = 0;
+      }
+   }
+   return *size < 2 || *size > tetrominoMaxSize || (mask & ~tetrominoSizeMasks[*size]) || (mask && !color);
+}
+
+TETRIS_ENGINE_API size_t packedGameStateMaxSize(GameCoordinate width, GameCoordinate height, unsigned flags) {
+   size_t pixels = (size_t) width * height;
+   size_t bits = 8 + 8 + 16 + 16 // версия, флаги, размеры стакана
+         + 2 + 32 // статус и очки
+         + 3 + 3 * tetrominoKindCount + 3 + 64 // генератор
+         + 5 + 32 + tetrominoQueueCapacity * packedTetrominoMaxBits // очередь
+         + packedTetrominoMaxBits + 2 + 16 + 16 // активное тетрамино
+         + 16 + pixels; // стакан
+   if (flags & colorsPackedGameStateFlag) {
+      bits += 8 + 255 * 8 + pixels * (8 + 3);
+   }
+   return (bits + 7) / 8;
+}
+
+TETRIS_ENGINE_API size_t packGameState(const Game* game, unsigned flags, uint8_t* buffer, size_t capacity) {
+   PackedStateWriter writer = {buffer, capacity, 0, 0, 0, 0};
+   flags &= colorsPackedGameStateFlag;
+   writePackedBits(&writer, packedGameStateVersion, 8);
+   writePackedBits(&writer, flags, 8);
+   writePackedBits(&writer, (uint16_t) getGameWidth(game), 16);
+   writePackedBits(&writer, (uint16_t) getGameHeight(game), 16);
+   writePackedBits(&writer, game->status, 2);
+   writePackedBits(&writer, game->score, 32);
+
+   const TetrominoGenerator* generator = &game->tetrominoGenerator;
+   writePackedBits(&writer, generator->type, 3);
+   if (generator->type == bagTetrominoGenerator) {
+      for (int i = 0; i < tetrominoKindCount; ++i) {
+         writePackedBits(&writer, generator->bag[i], 3);
+      }
+      writePackedBits(&writer, generator->bagPosition, 3);
+   }
+   if (generator->type == bagTetrominoGenerator || generator->type == uniformTetrominoGenerator) {
+      writePackedBits(&writer, (uint32_t) generator->state, 32);
+      writePackedBits(&writer, (uint32_t) (generator->state >> 32), 32);
+   } else if (generator->type == sequenceTetrominoGenerator || generator->type == logTetrominoGenerator) {
+      writePackedBits(&writer, generator->sequencePosition, 32);
+   }
+
+   const TetrominoQueue* queue = &game->tetrominoQueue;
+   writePackedBits(&writer, queue->count, 5);
+   writePackedBits(&writer, queue->total, 32);
+   for (unsigned i = 0; i < queue->count; ++i) {
+      unsigned slot = (queue->head + i) % tetrominoQueueCapacity;
+      writePackedTetromino(&writer, queue->pixels + slot * tetrominoArrayMaxSize, queue->sizes[slot]);
+   }
+
+   if (game->status != initGameStatus) {
+      const ActiveTetromino* activeTetromino = game->activeTetromino;
+      writePackedTetromino(&writer, activeTetromino->orientationPixels, activeTetromino->size);
+      writePackedBits(&writer, activeTetromino->orientation, 2);
+      writePackedBits(&writer, (uint16_t) activeTetromino->x, 16);
+      writePackedBits(&writer, (uint16_t) activeTetromino->y, 16);
+   }
+
+   // над самым высоким столбцом все строки пусты
+   int stackHeight = game->boardFeatures.maxHeight;
+   writePackedBits(&writer, (uint32_t) stackHeight, 16);
+   for (int y = 0; y < stackHeight; ++y) {
+      for (int x = 0; x < getGameWidth(game); x += 32) {
+         int count = getGameWidth(game) - x < 32 ? getGameWidth(game) - x : 32;
+         writePackedBits(&writer, getOccupancyBits(game, x, y, count), count);
+      }
+   }
+
+   if (flags & colorsPackedGameStateFlag) {
+      // палитра из цветов зафиксированных пикселов, затем серии пикселов
+      // одного цвета: номер в палитре и длина - 1
+      uint8_t paletteIndices[256] = {0};
+      TetrominoPixel palette[255];
+      unsigned paletteCount = 0;
+      forEachLockedPixel(game, stackHeight, {
+         if (!paletteIndices[pixel]) {
+            palette[paletteCount] = pixel;
+            paletteIndices[pixel] = (uint8_t) ++paletteCount;
+         }
+      });
+      writePackedBits(&writer, paletteCount, 8);
+      for (unsigned i = 0; i < paletteCount; ++i) {
+         writePackedBits(&writer, palette[i], 8);
+      }
+      int indexBits = getPackedIndexBits(paletteCount);
+      TetrominoPixel runColor = 0;
+      unsigned runLength = 0;
+      forEachLockedPixel(game, stackHeight, {
+         if (runLength && (pixel != runColor || runLength == packedColorRunMaxLength)) {
+            writePackedBits(&writer, paletteIndices[runColor] - 1u, indexBits);
+            writePackedBits(&writer, runLength - 1, 3);
+            runLength = 0;
+         }
+         runColor = pixel;
+         ++runLength;
+      });
+      if (runLength) {
+         writePackedBits(&writer, paletteIndices[runColor] - 1u, indexBits);
+         writePackedBits(&writer, runLength - 1, 3);
+      }
+   }
+
+   if (writer.bitCount) {
+      writePackedBits(&writer, 0, 8 - writer.bitCount);
+   }
+   return writer.isOverflowed ? 0 : writer.size;
+}
+
+/*!
+ * \brief Пересчитывает #Game::boardFeatures по #Game::columnHeights,
+ * #Game::rowFillCounts и битовой доске.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+static void computeBoardFeatures(Game* game) {
+   BoardFeatures* features = &game->boardFeatures;
+   clearColumnFeatures(features);
+   for (int x = 0; x < getGameWidth(game); ++x) {
+      addColumnFeatures(features, getColumnHeightOrWall(game, x - 1), game->columnHeights[x],
+            getColumnHeightOrWall(game, x + 1));
+   }
+   features->lockedPixels = 0;
+   // пустая строка дает две смены занятости: у левой и у правой стены
+   features->rowTransitions = 2 * (uint32_t) (getGameHeight(game) - features->maxHeight);
+   for (int y = 0; y < features->maxHeight; ++y) {
+      features->lockedPixels += game->rowFillCounts[y];
+      for (int x = -1; x < getGameWidth(game); x += tetrominoMaxSize + 1) {
+         int count = getGameWidth(game) + 1 - x < tetrominoMaxSize + 2 ? getGameWidth(game) + 1 - x : tetrominoMaxSize + 2;
+         unsigned bits = getOccupancyBits(game, x, y, count) | ~0u << count;
+         features->rowTransitions += countRowTransitions(bits);
+      }
+   }
+   features->holes = features->aggregateHeight - features->lockedPixels;
+}
+
+/*!
+ * \brief Пересчитывает #Game::rowHashes и #Game::boardHash по
+ * зафиксированным пикселам.
+ * 
+ * \warning #Game::boardFeatures должны быть уже вычислены.
+ * 
+ * \param[in,out] game указатель на структуру
+ */
+static void computeBoardHash(Game* game) {
+   memset(game->rowHashes, 0, getGameHeight(game) * sizeof(uint64_t));
+   forEachLockedPixel(game, game->boardFeatures.maxHeight, {
+      game->rowHashes[y] ^= getPixelHashKey(x, pixel);
+   });
+   game->boardHash = 0;
+   for (int y = 0; y < game->boardFeatures.maxHeight; ++y) {
+      game->boardHash ^= getRowHashContribution(game->rowHashes[y], y);
+   }
+}
+#undef forEachLockedPixel
+
+/*!
+ * \brief Читает упакованное состояние игры.
+ * 
+ * Сначала вызывается с \a isApplied равным \a 0, чтобы проверить буфер не
+ * меняя игру, затем с \a 1.
+ * 
+ * \param[in,out] game игра
+ * \param[in] buffer упакованное состояние
+ * \param[in] size размер упакованного состояния в байтах
+ * \param[in] isApplied если не \a 0, то состояние записывается в игру
+ * 
+ * \return
+ *          - 1) \a 0 если состояние прочитано;
+ *          - 2) \a 1 если оно испорчено или не подходит к игре.
+ */
+static unsigned readPackedGameState(Game* game, const uint8_t* buffer, size_t size, unsigned isApplied) {
+   PackedStateReader reader = {buffer, size, 0, 0, 0, 0};
+   unsigned version = readPackedBits(&reader, 8);
+   unsigned flags = readPackedBits(&reader, 8);
+   unsigned width = readPackedBits(&reader, 16);
+   unsigned height = readPackedBits(&reader, 16);
+   if (version != packedGameStateVersion || flags & ~(unsigned) colorsPackedGameStateFlag
+         || width != (uint16_t) getGameWidth(game) || height != (uint16_t) getGameHeight(game)) {
+      return 1;
+   }
+   GameStatus status = (GameStatus) readPackedBits(&reader, 2);
+   uint32_t score = readPackedBits(&reader, 32);
+
+   TetrominoGenerator generator = game->tetrominoGenerator;
+   generator.type = (TetrominoGeneratorType) readPackedBits(&reader, 3);
+   if (generator.type > logTetrominoGenerator) {
+      return 1;
+   }
+   if (generator.type == bagTetrominoGenerator) {
+      for (int i = 0; i < tetrominoKindCount; ++i) {
+         generator.bag[i] = (uint8_t) readPackedBits(&reader, 3);
+         if (generator.bag[i] >= tetrominoKindCount) {
+            return 1;
+         }
+      }
+      generator.bagPosition = (uint8_t) readPackedBits(&reader, 3);
+   }
+   if (generator.type == bagTetrominoGenerator || generator.type == uniformTetrominoGenerator) {
+      generator.state = readPackedBits(&reader, 32);
+      generator.state |= (uint64_t) readPackedBits(&reader, 32) << 32;
+   } else if (generator.type == sequenceTetrominoGenerator || generator.type == logTetrominoGenerator) {
+      // последовательность и журнал не упаковываются: используются те, что
+      // уже установлены в игре
+      generator.sequencePosition = readPackedBits(&reader, 32);
+      if (generator.type != game->tetrominoGenerator.type || generator.sequencePosition > generator.sequenceLength
+            || (generator.type == sequenceTetrominoGenerator && generator.sequencePosition == generator.sequenceLength)) {
+         return 1;
+      }
+   }
+
+   TetrominoPixel queuePixels[tetrominoQueueCapacity * tetrominoArrayMaxSize] = {0};
+   int8_t queueSizes[tetrominoQueueCapacity] = {0};
+   uint8_t queueCount = (uint8_t) readPackedBits(&reader, 5);
+   uint32_t queueTotal = readPackedBits(&reader, 32);
+   if (queueCount > tetrominoQueueCapacity) {
+      return 1;
+   }
+   for (unsigned i = 0; i < queueCount; ++i) {
+      if (readPackedTetromino(&reader, queuePixels + i * tetrominoArrayMaxSize, queueSizes + i)) {
+         return 1;
+      }
+   }
+
+   TetrominoPixel activePixels[tetrominoArrayMaxSize];
+   NextTetromino activeTetromino = {0, activePixels};
+   uint8_t orientation = 0;
+   int16_t activeX = 0;
+   int16_t activeY = 0;
+   uint16_t activeMask = 0;
+   if (status != initGameStatus) {
+      if (readPackedTetromino(&reader, activePixels, &activeTetromino.size)) {
+         return 1;
+      }
+      orientation = (uint8_t) readPackedBits(&reader, 2);
+      activeX = (int16_t) readPackedBits(&reader, 16);
+      activeY = (int16_t) readPackedBits(&reader, 16);
+      if ((GameCoordinate) activeX != activeX || (GameCoordinate) activeY != activeY) {
+         return 1;
+      }
+      for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+         activeMask |= activePixels[i] ? 1u << i : 0;
+      }
+      for (int i = 0; i < orientation; ++i) {
+         activeMask = rotateTetrominoMask(activeMask, activeTetromino.size);
+      }
+      // активное тетрамино может выступать над стаканом не больше, чем
+      // только что появившееся
+      for (int i = 0; i < tetrominoArrayMaxSize; ++i) {
+         int pixelX = activeX + i % tetrominoMaxSize;
+         int pixelY = activeY + i / tetrominoMaxSize;
+         if ((activeMask >> i) & 1 && (pixelX < 0 || pixelX >= getGameWidth(game) || pixelY < 0
+               || pixelY >= getGameHeight(game) + tetrominoMaxSize)) {
+            return 1;
+         }
+      }
+   }
+
+   int stackHeight = (int) readPackedBits(&reader, 16);
+   if (stackHeight > getGameHeight(game)) {
+      return 1;
+   }
+   if (isApplied) {
+      memset(game->gameField, 0, (size_t) getGameWidth(game) * getGameHeight(game) * sizeof(TetrominoPixel));
+      memset(game->columnHeights, 0, getGameWidth(game) * sizeof(GameCoordinate));
+      memset(game->rowFillCounts, 0, getGameHeight(game) * sizeof(GameCoordinate));
+      initOccupancy(game);
+   }
+   uint32_t lockedPixels = 0;
+   for (int y = 0; y < stackHeight; ++y) {
+      for (int x = 0; x < getGameWidth(game); x += 32) {
+         int count = getGameWidth(game) - x < 32 ? getGameWidth(game) - x : 32;
+         unsigned bits = readPackedBits(&reader, count);
+         lockedPixels += (uint32_t) countMaskBits(bits);
+         // активное тетрамино не должно пересекаться с зафиксированными
+         // пикселами
+         int activeRow = y - activeY;
+         int activeColumn = activeX - x;
+         if (activeRow >= 0 && activeRow < tetrominoMaxSize && activeColumn > -tetrominoMaxSize && activeColumn < 32) {
+            uint64_t activeBits = (activeMask >> activeRow * tetrominoMaxSize) & ((1u << tetrominoMaxSize) - 1);
+            activeBits = activeColumn >= 0 ? activeBits << activeColumn : activeBits >> -activeColumn;
+            if (bits & activeBits) {
+               return 1;
+            }
+         }
+         if (!isApplied) {
+            continue;
+         }
+         uint64_t* row = getOccupancyRow(game, y);
+         unsigned bit = x + occupancyPadding;
+         unsigned shift = bit & 63;
+         row[bit >> 6] |= (uint64_t) bits << shift;
+         if (shift > 64u - count) {
+            row[(bit >> 6) + 1] |= (uint64_t) bits >> (64 - shift);
+         }
+         game->rowFillCounts[y] += (GameCoordinate) countMaskBits(bits);
+         for (int pixelX = x; bits; ++pixelX, bits >>= 1) {
+            if (bits & 1) {
+               // без цветов все зафиксированные пикселы равны 1
+               flatArrayAs2D(game->gameField, pixelX, y, getGameWidth(game)) = 1;
+               game->columnHeights[pixelX] = (GameCoordinate) (y + 1);
+            }
+         }
+      }
+   }
+   if (flags & colorsPackedGameStateFlag) {
+      TetrominoPixel palette[255];
+      unsigned paletteCount = readPackedBits(&reader, 8);
+      for (unsigned i = 0; i < paletteCount; ++i) {
+         palette[i] = (TetrominoPixel) readPackedBits(&reader, 8);
+         if (!palette[i]) {
+            return 1;
+         }
+      }
+      int indexBits = getPackedIndexBits(paletteCount);
+      int pixelIndex = 0;
+      for (uint32_t pixel = 0; pixel < lockedPixels && !reader.isOverflowed;) {
+         unsigned index = readPackedBits(&reader, indexBits);
+         unsigned length = readPackedBits(&reader, 3) + 1;
+         if (index >= paletteCount || length > lockedPixels - pixel) {
+            return 1;
+         }
+         pixel += length;
+         for (; isApplied && length; ++pixelIndex) {
+            if (game->gameField[pixelIndex]) {
+               game->gameField[pixelIndex] = palette[index];
+               --length;
+            }
+         }
+      }
+   }
+   if (reader.isOverflowed) {
+      return 1;
+   }
+   if (!isApplied) {
+      return 0;
+   }
+
+   computeBoardFeatures(game);
+   computeBoardHash(game);
+   game->status = status;
+   game->score = score;
+   game->tetrominoGenerator = generator;
+   copyTetrominoQueue(game, 0, queueCount, queuePixels, queueSizes);
+   game->tetrominoQueue.total = queueTotal;
+   if (status != initGameStatus) {
+      ActiveTetromino* active = game->activeTetromino;
+      setActiveTetromino(game, &activeTetromino, (GameCoordinate) activeX);
+      active->y = (GameCoordinate) activeY;
+      active->orientation = orientation;
+      active->pixels = active->orientationPixels + orientation * tetrominoArrayMaxSize;
+   }
+   convertGameField(game, lockedGameFieldMode);
+   markGameDirty(game);
+   publishGameView(game);
+   return 0;
+}
+
+TETRIS_ENGINE_API unsigned unpackGameState(Game* game, const uint8_t* buffer, size_t size) {
+   if (readPackedGameState(game, buffer, size, 0)) {
+      return 1;
+   }
+   return readPackedGameState(game, buffer, size, 1);
+}
+
+/*!
+ * \brief Размер заголовка архива упакованных состояний в байтах.
+ *
+ * Заголовок: "TSTA", версия, флаги #PackedGameStateFlag, #Game::width и
+ * #Game::height (по 2 байта).
+ */
+#define gameStateArchiveHeaderSize 10
+
+/*!
+ * \brief Размер концевика архива упакованных состояний в байтах.
+ *
+ * Концевик: смещение индекса (8 байтов) и количество состояний (4 байта).
+ */
+#define gameStateArchiveFooterSize 12
+
+/*!
+ * \brief Версия формата архива упакованных состояний.
+ */
+#define gameStateArchiveVersion 1
+
+TETRIS_ENGINE_API unsigned startGameStateArchive(GameStateArchiveWriter* writer, GameCoordinate width,
+      GameCoordinate height, unsigned flags) {
+   memset(writer, 0, sizeof(GameStateArchiveWriter));
+   writer->width = width;
+   writer->height = height;
+   writer->flags = flags & colorsPackedGameStateFlag;
+   uint8_t* header = reserveLogStream(&writer->outOfMemory, &writer->bytes, gameStateArchiveHeaderSize);
+   if (!header) {
+      return 1;
+   }
+   memcpy(header, "TSTA", 4);
+   header[4] = gameStateArchiveVersion;
+   header[5] = (uint8_t) writer->flags;
+   writeLittleEndian(header + 6, (uint16_t) width, 2);
+   writeLittleEndian(header + 8, (uint16_t) height, 2);
+   writer->position = gameStateArchiveHeaderSize;
+   return 0;
+}
+
+TETRIS_ENGINE_API int appendGameState(GameStateArchiveWriter* writer, const Game* game) {
+   if (getGameWidth(game) != writer->width || getGameHeight(game) != writer->height) {
+      return 1;
+   }
+   size_t maxSize = packedGameStateMaxSize(writer->width, writer->height, writer->flags);
+   uint8_t* offset = reserveLogStream(&writer->outOfMemory, &writer->offsets, 8);
+   uint8_t* place = offset ? reserveLogStream(&writer->outOfMemory, &writer->bytes, maxSize) : NULL;
+   if (!place) {
+      return -1;
+   }
+   writeLittleEndian(offset, writer->position, 8);
+   size_t size = packGameState(game, writer->flags, place, maxSize);
+   // зарезервировано с запасом: лишнее возвращается в буфер
+   writer->bytes.size -= maxSize - size;
+   writer->position += size;
+   ++writer->count;
+   return 0;
+}
+
+TETRIS_ENGINE_API const uint8_t* flushGameStateArchive(GameStateArchiveWriter* writer, size_t* size) {
+   *size = writer->bytes.size;
+   writer->bytes.size = 0;
+   return writer->bytes.data;
+}
+
+TETRIS_ENGINE_API uint8_t* finishGameStateArchive(GameStateArchiveWriter* writer, size_t* size) {
+   uint64_t indexPosition = writer->position;
+   size_t indexSize = writer->offsets.size + 8;
+   uint8_t* place = reserveLogStream(&writer->outOfMemory, &writer->bytes, indexSize + gameStateArchiveFooterSize);
+   uint8_t* bytes = NULL;
+   if (place && !writer->outOfMemory) {
+      if (writer->offsets.size) {
+         memcpy(place, writer->offsets.data, writer->offsets.size);
+      }
+      writeLittleEndian(place + writer->offsets.size, indexPosition, 8);
+      writeLittleEndian(place + indexSize, indexPosition, 8);
+      writeLittleEndian(place + indexSize + 8, writer->count, 4);
+      bytes = writer->bytes.data;
+      *size = writer->bytes.size;
+      writer->bytes.data = NULL;
+   }
+   freeGameStateArchiveWriter(writer);
+   return bytes;
+}
+
+TETRIS_ENGINE_API void freeGameStateArchiveWriter(GameStateArchiveWriter* writer) {
+   free(writer->bytes.data);
+   free(writer->offsets.data);
+   writer->bytes.data = writer->offsets.data = NULL;
+   writer->bytes.size = writer->offsets.size = 0;
+   writer->bytes.capacity = writer->offsets.capacity = 0;
+}
+
+TETRIS_ENGINE_API unsigned openGameStateArchive(GameStateArchive* archive, const uint8_t* data, size_t size) {
+   if (size < gameStateArchiveHeaderSize + 8 + gameStateArchiveFooterSize || memcmp(data, "TSTA", 4)
+         || data[4] != gameStateArchiveVersion || data[5] & ~(unsigned) colorsPackedGameStateFlag) {
+      return 1;
+   }
+   const uint8_t* footer = data + size - gameStateArchiveFooterSize;
+   uint64_t indexPosition = readLittleEndian(footer, 8);
+   uint64_t count = readLittleEndian(footer + 8, 4);
+   // индекс: count + 1 смещений сразу перед концевиком
+   if (indexPosition < gameStateArchiveHeaderSize || indexPosition > size
+         || indexPosition + (count + 1) * 8 != size - gameStateArchiveFooterSize
+         || readLittleEndian(data + indexPosition + count * 8, 8) != indexPosition) {
+      return 1;
+   }
+   archive->data = data;
+   archive->index = data + indexPosition;
+   archive->width = (GameCoordinate) readLittleEndian(data + 6, 2);
+   archive->height = (GameCoordinate) readLittleEndian(data + 8, 2);
+   archive->flags = data[5];
+   archive->count = (uint32_t) count;
+   return 0;
+}
+
+TETRIS_ENGINE_API const uint8_t* getArchivedGameState(const GameStateArchive* archive, uint32_t index, size_t* size) {
+   if (index >= archive->count) {
+      return NULL;
+   }
+   uint64_t begin = readLittleEndian(archive->index + (size_t) index * 8, 8);
+   uint64_t end = readLittleEndian(archive->index + (size_t) index * 8 + 8, 8);
+   if (begin < gameStateArchiveHeaderSize || begin > end || end > (uint64_t) (archive->index - archive->data)) {
+      return NULL;
+   }
+   *size = (size_t) (end - begin);
+   return archive->data + begin;
+}
+
+TETRIS_ENGINE_API void freeGame(Game* game) {
+#ifdef TETRIS_ENGINE_GAME_VIEW
+   if (game) {
+      detachGameView(game);
+   }
+#endif
+   free(game);
+}
+
+TETRIS_ENGINE_API GameBatch* initGameBatch(unsigned count, GameCoordinate width, GameCoordinate height, int32_t maxScore,
+      GetNextTetrominoFunction* const getNextTetrominoFunction, 
+      GetScoreAddendFunction* const getScoreAddendFunction) {
+   if (!isGameSizeSupported(width, height)) {
+      return NULL;
+   }
+   size_t occupancyWords = (size_t) (height + 2 * occupancyPadding) * getOccupancyRowWords(width);
+   size_t fieldSize = (size_t) width * height;
+   // каждый массив лежит в блоке непрерывно для всех игр: сначала поля
+   // с наибольшим выравниванием
+   size_t gamesOffset = alignMemoryBlock(sizeof(GameBatch));
+   size_t activeOffset = gamesOffset + alignMemoryBlock(count * sizeof(Game));
+   size_t nextOffset = activeOffset + alignMemoryBlock(count * sizeof(ActiveTetromino));
+   size_t eventsOffset = nextOffset + alignMemoryBlock(count * sizeof(NextTetromino));
+   size_t shapesOffset = eventsOffset + alignMemoryBlock(count * gameEventQueueCapacity * sizeof(GameEvent));
+   size_t occupancyOffset = shapesOffset + alignMemoryBlock(count * tetrominoShapeCapacity * sizeof(TetrominoShape));
+   size_t rowHashesOffset = occupancyOffset + count * occupancyWords * sizeof(uint64_t);
+   size_t dirtyRowsOffset = rowHashesOffset + count * height * sizeof(uint64_t);
+   size_t scoresOffset = dirtyRowsOffset + count * dirtyRowWords(height) * sizeof(uint64_t);
+   size_t statusesOffset = scoresOffset + alignMemoryBlock(count * sizeof(uint32_t));
+   size_t orientationOffset = statusesOffset + alignMemoryBlock(count * sizeof(GameStatus));
+   size_t queuePixelsOffset = orientationOffset + count * tetrominoOrientationCount * tetrominoArrayMaxSize;
+   size_t queueSizesOffset = queuePixelsOffset + count * tetrominoQueueCapacity * tetrominoArrayMaxSize;
+   size_t columnHeightsOffset = queueSizesOffset + count * tetrominoQueueCapacity;
+   size_t rowFillCountsOffset = columnHeightsOffset + count * width * sizeof(GameCoordinate);
+   size_t fieldOffset = rowFillCountsOffset + count * height * sizeof(GameCoordinate);
+   size_t totalSize = fieldOffset + count * fieldSize;
+   uint8_t* block = (uint8_t*) malloc(totalSize);
+   if (!block) {
+      return NULL;
+   }
+   GameBatch* batch = (GameBatch*) block;
+   *(unsigned*) &batch->count = count;
+   *(Game**) &batch->games = (Game*) (block + gamesOffset);
+   *(uint32_t**) &batch->scores = (uint32_t*) (block + scoresOffset);
+   *(GameStatus**) &batch->statuses = (GameStatus*) (block + statusesOffset);
+   for (unsigned i = 0; i < count; ++i) {
+      // массив, забытый в раскладке пакета, останется NULL, а не мусором
+      GameMemory memory = {0};
+      memory.game = batch->games + i;
+      memory.activeTetromino = (ActiveTetromino*) (block + activeOffset) + i;
+      memory.nextTetromino = (NextTetromino*) (block + nextOffset) + i;
+      memory.events = (GameEvent*) (block + eventsOffset) + i * gameEventQueueCapacity;
+      memory.shapes = (TetrominoShape*) (block + shapesOffset) + i * tetrominoShapeCapacity;
+      memory.occupancy = (uint64_t*) (block + occupancyOffset) + i * occupancyWords;
+      memory.rowHashes = (uint64_t*) (block + rowHashesOffset) + i * height;
+      memory.dirtyRows = (uint64_t*) (block + dirtyRowsOffset) + i * dirtyRowWords(height);
+      memory.orientationPixels = block + orientationOffset + i * tetrominoOrientationCount * tetrominoArrayMaxSize;
+      memory.queuePixels = block + queuePixelsOffset + i * tetrominoQueueCapacity * tetrominoArrayMaxSize;
+      memory.queueSizes = (int8_t*) (block + queueSizesOffset) + i * tetrominoQueueCapacity;
+      memory.gameField = block + fieldOffset + i * fieldSize;
+      memory.columnHeights = (GameCoordinate*) (block + columnHeightsOffset) + i * width;
+      memory.rowFillCounts = (GameCoordinate*) (block + rowFillCountsOffset) + i * height;
+      assembleGame(&memory, width, height, maxScore, getNextTetrominoFunction, getScoreAddendFunction);
+      batch->scores[i] = 0;
+      batch->statuses[i] = initGameStatus;
+   }
+   return batch;
+}
+
+TETRIS_ENGINE_API void startGameBatch(GameBatch* batch) {
+   for (unsigned i = 0; i < batch->count; ++i) {
+      startGame(batch->games + i);
+      batch->statuses[i] = batch->games[i].status;
+   }
+}
+
+TETRIS_ENGINE_API unsigned stepGameBatch(GameBatch* batch, const GameInput* inputs, unsigned* results) {
+   unsigned playingGames = 0;
+   for (unsigned i = 0; i < batch->count; ++i) {
+      Game* game = batch->games + i;
+      unsigned result = 0;
+      if (batch->statuses[i] == playGameStatus) {
+         result = applyInput(game, inputs ? inputs[i] : tickInput);
+         batch->scores[i] = game->score;
+         batch->statuses[i] = game->status;
+         playingGames += game->status == playGameStatus;
+      }
+      if (results) {
+         results[i] = result;
+      }
+   }
+   return playingGames;
+}
+
+TETRIS_ENGINE_API void freeGameBatch(GameBatch* batch) {
+#ifdef TETRIS_ENGINE_GAME_VIEW
+   for (unsigned i = 0; i < batch->count; ++i) {
+      detachGameView(batch->games + i);
+   }
+#endif
+   free(batch);
+}
+
+#ifdef TETRIS_ENGINE_STATS
+TETRIS_ENGINE_API const GameStats* getGameStats(const Game* game) {
+   return &game->stats;
+}
+
+TETRIS_ENGINE_API void resetGameStats(Game* game) {
+   memset(&game->stats, 0, sizeof(GameStats));
 }
+#endif
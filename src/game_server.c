@@ -0,0 +1,279 @@
+#include <stdatomic.h> // for atomic_uint, atomic_bool, atomic_uint_fast64_t
+#include <stdlib.h> // for aligned_alloc, calloc, free, malloc
+#include <threads.h> // for thrd_create, thrd_join, thrd_yield
+#include <time.h> // for timespec_get
+
+#include <game_server.h>
+
+/*!
+ * \brief Размер кеш-линии. Данные, которые пишут разные потоки, разносятся
+ * по разным кеш-линиям.
+ */
+#define cacheLineSize 64
+
+/*!
+ * \brief Очередь ввода одной игры с одним писателем и одним читателем.
+ *
+ * Индексы растут неограниченно (по модулю 2^32), элемент с индексом \a i
+ * лежит в #inputs[\a i % #gameInputQueueCapacity].
+ */
+typedef struct tagGameInputQueue {
+   /*!
+    * \brief Индекс, по которому писатель добавит следующий ввод.
+    */
+   _Alignas(cacheLineSize) atomic_uint tail;
+   /*!
+    * \brief Последнее прочитанное писателем значение #head. Используется
+    * только писателем, чтобы реже читать кеш-линию читателя.
+    */
+   unsigned cachedHead;
+   /*!
+    * \brief Индекс следующего непрочитанного ввода.
+    */
+   _Alignas(cacheLineSize) atomic_uint head;
+   /*!
+    * \brief Ввод (значения #GameInput).
+    */
+   _Alignas(cacheLineSize) uint8_t inputs[gameInputQueueCapacity];
+} GameInputQueue;
+
+/*!
+ * \brief Рабочий поток сервера.
+ */
+typedef struct tagGameServerWorker {
+   _Alignas(cacheLineSize) GameServer* server; ///< сервер
+   thrd_t thread;                             ///< поток
+   unsigned firstGame;                        ///< номер первой игры потока
+   unsigned lastGame;                         ///< номер игры после последней игры потока
+   atomic_uint_fast64_t appliedInputs;        ///< #GameServerStats::appliedInputs
+   atomic_uint_fast64_t ticks;                ///< #GameServerStats::ticks
+   atomic_uint_fast64_t restartedGames;       ///< #GameServerStats::restartedGames
+   atomic_uint_fast64_t passes;               ///< #GameServerStats::passes
+} GameServerWorker;
+
+struct tagGameServer {
+   GameServerConfig config;     ///< параметры сервера
+   GameBatch* batch;            ///< все игры
+   GameInputQueue* queues;      ///< очереди ввода, по одной на игру
+   uint64_t* nextTicks;         ///< время следующего #tick каждой игры
+   uint32_t* restartCounts;     ///< количество перезапусков каждой игры
+   void* initialSnapshot;       ///< снимок игры до #startGame
+   GameServerWorker* workers;   ///< рабочие потоки
+   unsigned startedWorkers;     ///< количество созданных потоков
+   atomic_bool stopping;        ///< потоки должны завершиться
+};
+
+/*!
+ * \brief Возвращает текущее время в наносекундах.
+ *
+ * \return время в наносекундах
+ */
+static uint64_t readServerClock(void) {
+   struct timespec time;
+   timespec_get(&time, TIME_UTC);
+   return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
+}
+
+/*!
+ * \brief Задает генератор тетрамино игры.
+ *
+ * \param[in] server сервер
+ * \param[in,out] game игра
+ * \param[in] gameIndex номер игры
+ */
+static void seedServerGame(const GameServer* server, Game* game, unsigned gameIndex) {
+   if (server->config.generatorType == functionTetrominoGenerator) {
+      return;
+   }
+   // перезапуски меняют старшие биты зерна, чтобы не совпасть с зерном
+   // другой игры
+   uint64_t seed = server->config.seed + gameIndex + ((uint64_t) server->restartCounts[gameIndex] << 32);
+   setTetrominoGenerator(game, server->config.generatorType, seed);
+}
+
+/*!
+ * \brief Возвращает закончившуюся игру в начальное состояние и запускает ее.
+ *
+ * \param[in,out] server сервер
+ * \param[in] gameIndex номер игры
+ */
+static void restartServerGame(GameServer* server, unsigned gameIndex) {
+   Game* game = server->batch->games + gameIndex;
+   restoreGame(game, server->initialSnapshot);
+   ++server->restartCounts[gameIndex];
+   seedServerGame(server, game, gameIndex);
+   startGame(game);
+}
+
+/*!
+ * \brief Цикл рабочего потока: применяет ввод из очередей своих игр и
+ * вызывает #tick, пока сервер не остановят.
+ *
+ * \param[in,out] argument рабочий поток (#GameServerWorker)
+ *
+ * \return \a 0
+ */
+static int runGameServerWorker(void* argument) {
+   GameServerWorker* worker = (GameServerWorker*) argument;
+   GameServer* server = worker->server;
+   const uint64_t tickNanoseconds = server->config.tickNanoseconds;
+   uint64_t appliedInputs = 0;
+   uint64_t ticks = 0;
+   uint64_t restartedGames = 0;
+   uint64_t passes = 0;
+   while (!atomic_load_explicit(&server->stopping, memory_order_acquire)) {
+      uint64_t now = tickNanoseconds ? readServerClock() : 0;
+      unsigned isWorkDone = 0;
+      for (unsigned i = worker->firstGame; i < worker->lastGame; ++i) {
+         Game* game = server->batch->games + i;
+         GameInputQueue* queue = server->queues + i;
+         unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+         unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+         if (head != tail) {
+            for (; head != tail; ++head) {
+               if (game->status == playGameStatus) {
+                  applyInput(game, (GameInput) queue->inputs[head % gameInputQueueCapacity]);
+                  ++appliedInputs;
+               }
+            }
+            atomic_store_explicit(&queue->head, head, memory_order_release);
+            isWorkDone = 1;
+         }
+         if (game->status == playGameStatus && now >= server->nextTicks[i]) {
+            tick(game);
+            ++ticks;
+            // отставший поток не пытается догнать пропущенные тики
+            server->nextTicks[i] = now + tickNanoseconds;
+            isWorkDone = 1;
+         }
+         if (game->status != playGameStatus && server->config.restartEndedGames) {
+            restartServerGame(server, i);
+            server->nextTicks[i] = now + tickNanoseconds;
+            ++restartedGames;
+            isWorkDone = 1;
+         }
+      }
+      ++passes;
+      // счетчики пишет только этот поток, поэтому хватает простой записи
+      atomic_store_explicit(&worker->appliedInputs, appliedInputs, memory_order_relaxed);
+      atomic_store_explicit(&worker->ticks, ticks, memory_order_relaxed);
+      atomic_store_explicit(&worker->restartedGames, restartedGames, memory_order_relaxed);
+      atomic_store_explicit(&worker->passes, passes, memory_order_relaxed);
+      if (!isWorkDone) {
+         thrd_yield();
+      }
+   }
+   return 0;
+}
+
+GameServer* startGameServer(const GameServerConfig* config) {
+   if (!config->workerCount || config->gameCount < config->workerCount) {
+      return NULL;
+   }
+   GameServer* server = (GameServer*) calloc(1, sizeof(GameServer));
+   if (!server) {
+      return NULL;
+   }
+   server->config = *config;
+   atomic_init(&server->stopping, 0);
+   server->batch = initGameBatch(config->gameCount, config->width, config->height, config->maxScore,
+         config->getNextTetromino, config->getScoreAddend);
+   server->queues = (GameInputQueue*) aligned_alloc(cacheLineSize, config->gameCount * sizeof(GameInputQueue));
+   server->workers = (GameServerWorker*) aligned_alloc(cacheLineSize, config->workerCount * sizeof(GameServerWorker));
+   server->nextTicks = (uint64_t*) calloc(config->gameCount, sizeof(uint64_t));
+   server->restartCounts = (uint32_t*) calloc(config->gameCount, sizeof(uint32_t));
+   if (!(server->batch && server->queues && server->workers && server->nextTicks && server->restartCounts)) {
+      freeGameServer(server);
+      return NULL;
+   }
+   // все игры одного размера, поэтому начальное состояние у них общее
+   server->initialSnapshot = malloc(gameSnapshotSize(server->batch->games));
+   if (!server->initialSnapshot) {
+      freeGameServer(server);
+      return NULL;
+   }
+   snapshotGame(server->batch->games, server->initialSnapshot);
+   for (unsigned i = 0; i < config->gameCount; ++i) {
+      atomic_init(&server->queues[i].tail, 0);
+      server->queues[i].cachedHead = 0;
+      atomic_init(&server->queues[i].head, 0);
+      seedServerGame(server, server->batch->games + i, i);
+   }
+   startGameBatch(server->batch);
+   // непрерывные диапазоны игр: соседние в памяти игры принадлежат одному
+   // потоку, и потоки не делят кеш-линии
+   for (unsigned i = 0; i < config->workerCount; ++i) {
+      GameServerWorker* worker = server->workers + i;
+      worker->server = server;
+      worker->firstGame = (unsigned) ((uint64_t) config->gameCount * i / config->workerCount);
+      worker->lastGame = (unsigned) ((uint64_t) config->gameCount * (i + 1) / config->workerCount);
+      atomic_init(&worker->appliedInputs, 0);
+      atomic_init(&worker->ticks, 0);
+      atomic_init(&worker->restartedGames, 0);
+      atomic_init(&worker->passes, 0);
+   }
+   for (; server->startedWorkers < config->workerCount; ++server->startedWorkers) {
+      GameServerWorker* worker = server->workers + server->startedWorkers;
+      if (thrd_create(&worker->thread, runGameServerWorker, worker) != thrd_success) {
+         freeGameServer(server);
+         return NULL;
+      }
+   }
+   return server;
+}
+
+unsigned pushGameServerInput(GameServer* server, unsigned gameIndex, GameInput input) {
+   GameInputQueue* queue = server->queues + gameIndex;
+   unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+   if (tail - queue->cachedHead == gameInputQueueCapacity) {
+      queue->cachedHead = atomic_load_explicit(&queue->head, memory_order_acquire);
+      if (tail - queue->cachedHead == gameInputQueueCapacity) {
+         return 1;
+      }
+   }
+   queue->inputs[tail % gameInputQueueCapacity] = (uint8_t) input;
+   atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+   return 0;
+}
+
+void stopGameServer(GameServer* server) {
+   atomic_store_explicit(&server->stopping, 1, memory_order_release);
+   for (unsigned i = 0; i < server->startedWorkers; ++i) {
+      thrd_join(server->workers[i].thread, NULL);
+   }
+   server->startedWorkers = 0;
+}
+
+void getGameServerStats(const GameServer* server, GameServerStats* stats) {
+   stats->appliedInputs = 0;
+   stats->ticks = 0;
+   stats->restartedGames = 0;
+   stats->passes = 0;
+   for (unsigned i = 0; i < server->config.workerCount; ++i) {
+      GameServerWorker* worker = server->workers + i;
+      stats->appliedInputs += atomic_load_explicit(&worker->appliedInputs, memory_order_relaxed);
+      stats->ticks += atomic_load_explicit(&worker->ticks, memory_order_relaxed);
+      stats->restartedGames += atomic_load_explicit(&worker->restartedGames, memory_order_relaxed);
+      stats->passes += atomic_load_explicit(&worker->passes, memory_order_relaxed);
+   }
+}
+
+const Game* getGameServerGame(const GameServer* server, unsigned gameIndex) {
+   return server->batch->games + gameIndex;
+}
+
+void freeGameServer(GameServer* server) {
+   if (!server) {
+      return;
+   }
+   stopGameServer(server);
+   if (server->batch) {
+      freeGameBatch(server->batch);
+   }
+   free(server->queues);
+   free(server->workers);
+   free(server->nextTicks);
+   free(server->restartCounts);
+   free(server->initialSnapshot);
+   free(server);
+}
@@ -0,0 +1,371 @@
+#include <stdatomic.h> // for atomic_uint
+#include <stdlib.h> // for aligned_alloc, free, malloc, realloc
+#include <threads.h> // for cnd_t, mtx_t, thrd_create, thrd_join
+
+#include <rollout.h>
+
+/*!
+ * \brief Размер кеш-линии. Счетчики разных потоков лежат в разных
+ * кеш-линиях.
+ */
+#define cacheLineSize 64
+
+/*!
+ * \brief Начальная длина массива положений потока. Массив растет, если
+ * #findPlacementsWithScratch нашла больше положений.
+ */
+#define rolloutInitialPlacements 256
+
+/*!
+ * \brief Параметры текущего вызова #rollout.
+ */
+typedef struct tagRolloutJob {
+   const Game* start;              ///< начальное состояние
+   RolloutPolicyFunction* policy;  ///< стратегия или \a NULL
+   void* policyContext;            ///< аргумент стратегии
+   unsigned count;                 ///< количество доигрываний
+   unsigned depth;                 ///< наибольшая длина доигрывания
+   uint64_t seed;                  ///< зерно
+} RolloutJob;
+
+/*!
+ * \brief Поток пула с его игрой, положениями и суммами по его
+ * доигрываниям.
+ */
+typedef struct tagRolloutWorker {
+   _Alignas(cacheLineSize) RolloutPool* pool; ///< пул
+   thrd_t thread;                    ///< поток. Не используется у потока с номером \a 0
+   void* gameMemory;                 ///< память игры (#initGameInPlace)
+   size_t gameMemorySize;            ///< размер #gameMemory
+   Placement* placements;            ///< положения текущего хода
+   unsigned placementCapacity;       ///< длина #placements
+   void* placementScratch;           ///< рабочая память #findPlacementsWithScratch
+   size_t placementScratchSize;      ///< размер #placementScratch
+   unsigned lostPlayouts;            ///< #RolloutResults::lostPlayouts
+   uint64_t score;                   ///< сумма набранных очков
+   uint64_t lines;                   ///< сумма очищенных строк
+   uint64_t pieces;                  ///< сумма зафиксированных тетрамино
+   uint32_t maxScore;                ///< #RolloutResults::maxScore
+   unsigned isFailed;                ///< не хватило памяти
+} RolloutWorker;
+
+struct tagRolloutPool {
+   RolloutWorker* workers;    ///< потоки; поток \a 0 - вызывающий #rollout
+   unsigned workerCount;      ///< количество потоков вместе с вызывающим
+   unsigned startedWorkers;   ///< количество созданных потоков
+   mtx_t mutex;               ///< защищает поля ниже
+   cnd_t jobStarted;          ///< #generation изменилось или #isStopping
+   cnd_t jobFinished;         ///< #busyWorkers стало равно \a 0
+   unsigned generation;       ///< номер текущего вызова #rollout
+   unsigned busyWorkers;      ///< потоки, еще не закончившие текущий вызов
+   unsigned isStopping;       ///< потоки должны завершиться
+   RolloutJob job;            ///< текущий вызов
+   atomic_uint nextPlayout;   ///< номер следующего незанятого доигрывания
+};
+
+uint64_t nextRolloutRandom(uint64_t* random) {
+   uint64_t z = (*random += 0x9E3779B97F4A7C15ull);
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+   return z ^ (z >> 31);
+}
+
+/*!
+ * \brief Выбирает положение равновероятно. Стратегия по умолчанию.
+ */
+static int chooseRandomPlacement(const Game* game, const Placement* placements, int count, uint64_t* random,
+      void* context) {
+   (void) game;
+   (void) placements;
+   (void) context;
+   return (int) (((nextRolloutRandom(random) >> 32) * (uint64_t) count) >> 32);
+}
+
+/*!
+ * \brief Находит положения активного тетрамино, увеличивая массив
+ * положений потока при необходимости.
+ *
+ * \param[in,out] worker поток
+ * \param[in,out] game игра
+ *
+ * \return
+ *          - 1) \a -1 в случае ошибки (нехватка памяти);
+ *          - 2) количество положений.
+ */
+static int findWorkerPlacements(RolloutWorker* worker, Game* game) {
+   for (;;) {
+      int count = findPlacementsWithScratch(game, worker->placementScratch, worker->placements,
+            worker->placementCapacity);
+      if (count < 0 || (unsigned) count <= worker->placementCapacity) {
+         return count;
+      }
+      Placement* placements = (Placement*) realloc(worker->placements, (size_t) count * sizeof(Placement));
+      if (!placements) {
+         return -1;
+      }
+      worker->placements = placements;
+      worker->placementCapacity = (unsigned) count;
+   }
+}
+
+/*!
+ * \brief Выполняет одно доигрывание и добавляет его итоги к суммам
+ * потока.
+ *
+ * \param[in,out] worker поток
+ * \param[in,out] game игра потока
+ * \param[in] job параметры вызова
+ * \param[in] playout номер доигрывания
+ *
+ * \return
+ *          - 1) \a 0 если доигрывание выполнено
+ *          - 2) \a 1 в случае ошибки (нехватка памяти)
+ */
+static unsigned runPlayout(RolloutWorker* worker, Game* game, const RolloutJob* job, unsigned playout) {
+   RolloutPolicyFunction* policy = job->policy ? job->policy : chooseRandomPlacement;
+   uint64_t random = job->seed + playout * 0x9E3779B97F4A7C15ull;
+   cloneGame(game, job->start);
+   // новое состояние генератора меняет тетрамино после очереди; очередь,
+   // которую видит игрок, остается как в начальном состоянии
+   game->tetrominoGenerator.state = nextRolloutRandom(&random);
+   random = nextRolloutRandom(&random);
+   uint32_t lines = 0;
+   unsigned pieces = 0;
+   for (; pieces < job->depth && game->status == playGameStatus; ++pieces) {
+      int count = findWorkerPlacements(worker, game);
+      if (count < 0) {
+         return 1;
+      }
+      if (!count) {
+         // любое положение заканчивается проигрышем
+         hardDrop(game, NULL);
+         ++pieces;
+         break;
+      }
+      const Placement* placement = worker->placements + policy(game, worker->placements, count, &random,
+            job->policyContext);
+      BoardFeatures features;
+      int cleanedRows = evaluatePlacement(game, placement, &features);
+      lines += cleanedRows > 0 ? (uint32_t) cleanedRows : 0;
+      placeActiveTetromino(game, placement);
+   }
+   uint32_t score = game->score - job->start->score;
+   worker->lostPlayouts += game->status == endPlayerLoose;
+   worker->score += score;
+   worker->lines += lines;
+   worker->pieces += pieces;
+   if (score > worker->maxScore) {
+      worker->maxScore = score;
+   }
+   return 0;
+}
+
+/*!
+ * \brief Забирает и выполняет доигрывания текущего вызова, пока они не
+ * кончатся.
+ *
+ * \param[in,out] worker поток
+ */
+static void runRolloutJob(RolloutWorker* worker) {
+   RolloutPool* pool = worker->pool;
+   const RolloutJob* job = &pool->job;
+   const Game* start = job->start;
+   worker->lostPlayouts = 0;
+   worker->score = 0;
+   worker->lines = 0;
+   worker->pieces = 0;
+   worker->maxScore = 0;
+   worker->isFailed = 0;
+   size_t gameSize = gameRequiredBytes(start->width, start->height);
+   if (gameSize > worker->gameMemorySize) {
+      free(worker->gameMemory);
+      worker->gameMemory = malloc(gameSize);
+      worker->gameMemorySize = worker->gameMemory ? gameSize : 0;
+   }
+   size_t scratchSize = placementScratchBytes(start->width, start->height);
+   if (scratchSize > worker->placementScratchSize) {
+      free(worker->placementScratch);
+      worker->placementScratch = malloc(scratchSize);
+      worker->placementScratchSize = worker->placementScratch ? scratchSize : 0;
+   }
+   if (!worker->gameMemory || !worker->placementScratch) {
+      worker->isFailed = 1;
+      return;
+   }
+   // игра создается заново в той же памяти: у нее могли поменяться размеры,
+   // максимум очков и функции
+   Game* game = initGameInPlace(worker->gameMemory, start->width, start->height, (int32_t) start->maxScore,
+         start->getNextTetromino, start->getScoreAddend);
+   for (;;) {
+      unsigned playout = atomic_fetch_add_explicit(&pool->nextPlayout, 1, memory_order_relaxed);
+      if (playout >= job->count) {
+         break;
+      }
+      if (runPlayout(worker, game, job, playout)) {
+         worker->isFailed = 1;
+         // остальные доигрывания заберут другие потоки, а вызов все равно
+         // вернет ошибку
+         break;
+      }
+   }
+}
+
+/*!
+ * \brief Цикл потока пула: ждет вызов #rollout, выполняет свою часть
+ * доигрываний и сообщает об окончании.
+ *
+ * \param[in,out] argument поток (#RolloutWorker)
+ *
+ * \return \a 0
+ */
+static int runRolloutWorker(void* argument) {
+   RolloutWorker* worker = (RolloutWorker*) argument;
+   RolloutPool* pool = worker->pool;
+   unsigned generation = 0;
+   for (;;) {
+      mtx_lock(&pool->mutex);
+      while (pool->generation == generation && !pool->isStopping) {
+         cnd_wait(&pool->jobStarted, &pool->mutex);
+      }
+      if (pool->isStopping) {
+         mtx_unlock(&pool->mutex);
+         return 0;
+      }
+      generation = pool->generation;
+      mtx_unlock(&pool->mutex);
+      runRolloutJob(worker);
+      mtx_lock(&pool->mutex);
+      if (!--pool->busyWorkers) {
+         cnd_signal(&pool->jobFinished);
+      }
+      mtx_unlock(&pool->mutex);
+   }
+}
+
+RolloutPool* initRolloutPool(unsigned workerCount) {
+   if (!workerCount) {
+      return NULL;
+   }
+   RolloutPool* pool = (RolloutPool*) calloc(1, sizeof(RolloutPool));
+   if (!pool) {
+      return NULL;
+   }
+   pool->workers = (RolloutWorker*) aligned_alloc(cacheLineSize, workerCount * sizeof(RolloutWorker));
+   if (!pool->workers) {
+      free(pool);
+      return NULL;
+   }
+   if (mtx_init(&pool->mutex, mtx_plain) != thrd_success) {
+      free(pool->workers);
+      free(pool);
+      return NULL;
+   }
+   if (cnd_init(&pool->jobStarted) != thrd_success) {
+      mtx_destroy(&pool->mutex);
+      free(pool->workers);
+      free(pool);
+      return NULL;
+   }
+   if (cnd_init(&pool->jobFinished) != thrd_success) {
+      cnd_destroy(&pool->jobStarted);
+      mtx_destroy(&pool->mutex);
+      free(pool->workers);
+      free(pool);
+      return NULL;
+   }
+   pool->workerCount = workerCount;
+   atomic_init(&pool->nextPlayout, 0);
+   for (unsigned i = 0; i < workerCount; ++i) {
+      RolloutWorker* worker = pool->workers + i;
+      worker->pool = pool;
+      worker->gameMemory = NULL;
+      worker->gameMemorySize = 0;
+      worker->placements = (Placement*) malloc(rolloutInitialPlacements * sizeof(Placement));
+      worker->placementCapacity = worker->placements ? rolloutInitialPlacements : 0;
+      worker->placementScratch = NULL;
+      worker->placementScratchSize = 0;
+   }
+   pool->startedWorkers = 1;
+   for (; pool->startedWorkers < workerCount; ++pool->startedWorkers) {
+      RolloutWorker* worker = pool->workers + pool->startedWorkers;
+      if (thrd_create(&worker->thread, runRolloutWorker, worker) != thrd_success) {
+         freeRolloutPool(pool);
+         return NULL;
+      }
+   }
+   return pool;
+}
+
+unsigned rollout(RolloutPool* pool, const Game* start, RolloutPolicyFunction* policy, void* policyContext,
+      unsigned count, unsigned depth, uint64_t seed, RolloutResults* results) {
+   mtx_lock(&pool->mutex);
+   pool->job.start = start;
+   pool->job.policy = policy;
+   pool->job.policyContext = policyContext;
+   pool->job.count = count;
+   pool->job.depth = depth;
+   pool->job.seed = seed;
+   atomic_store_explicit(&pool->nextPlayout, 0, memory_order_relaxed);
+   pool->busyWorkers = pool->startedWorkers - 1;
+   ++pool->generation;
+   cnd_broadcast(&pool->jobStarted);
+   mtx_unlock(&pool->mutex);
+   runRolloutJob(pool->workers);
+   mtx_lock(&pool->mutex);
+   while (pool->busyWorkers) {
+      cnd_wait(&pool->jobFinished, &pool->mutex);
+   }
+   mtx_unlock(&pool->mutex);
+
+   // суммы целые, поэтому итоги не зависят от того, какой поток какие
+   // доигрывания выполнил
+   unsigned lostPlayouts = 0;
+   uint64_t score = 0;
+   uint64_t lines = 0;
+   uint64_t pieces = 0;
+   uint32_t maxScore = 0;
+   for (unsigned i = 0; i < pool->workerCount; ++i) {
+      const RolloutWorker* worker = pool->workers + i;
+      if (worker->isFailed) {
+         return 1;
+      }
+      lostPlayouts += worker->lostPlayouts;
+      score += worker->score;
+      lines += worker->lines;
+      pieces += worker->pieces;
+      if (worker->maxScore > maxScore) {
+         maxScore = worker->maxScore;
+      }
+   }
+   double divisor = count ? (double) count : 1.0;
+   results->playouts = count;
+   results->lostPlayouts = lostPlayouts;
+   results->meanScore = (double) score / divisor;
+   results->meanLines = (double) lines / divisor;
+   results->meanPieces = (double) pieces / divisor;
+   results->maxScore = maxScore;
+   return 0;
+}
+
+void freeRolloutPool(RolloutPool* pool) {
+   if (!pool) {
+      return;
+   }
+   mtx_lock(&pool->mutex);
+   pool->isStopping = 1;
+   cnd_broadcast(&pool->jobStarted);
+   mtx_unlock(&pool->mutex);
+   for (unsigned i = 1; i < pool->startedWorkers; ++i) {
+      thrd_join(pool->workers[i].thread, NULL);
+   }
+   for (unsigned i = 0; i < pool->workerCount; ++i) {
+      free(pool->workers[i].gameMemory);
+      free(pool->workers[i].placements);
+      free(pool->workers[i].placementScratch);
+   }
+   cnd_destroy(&pool->jobFinished);
+   cnd_destroy(&pool->jobStarted);
+   mtx_destroy(&pool->mutex);
+   free(pool->workers);
+   free(pool);
+}